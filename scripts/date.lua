@@ -1,7 +1,9 @@
 require('strict').on()
 
+local topology = xci_ports[1].topology
+
 local ts = xp.unpack_le32(
-	xp():read_parameter_property(501, 5002, 0xD)
+	xp():read_parameter_property(topology.rcc, 5002, 0xD)
 	)
 
 return { ts, os.date('!%Y-%m-%dT%TZ', ts), }
@@ -0,0 +1,5 @@
+require('strict').on()
+
+local topology = xci_ports[1].topology
+
+return xp.load_datalog(box.space.xci_datalog.id, xp():read_datalog_file(topology.rcc, "LG200921.CSV"))
@@ -1,3 +1,5 @@
 require('strict').on()
 
-return xp():read_datalog_dir(501)
+local topology = xci_ports[1].topology
+
+return xp():read_datalog_dir(topology.rcc)
@@ -1,3 +1,5 @@
 require('strict').on()
 
-return xp():read_datalog_file(501, "LG200921.CSV")
+local topology = xci_ports[1].topology
+
+return xp():read_datalog_file(topology.rcc, "LG200921.CSV")
@@ -1,5 +1,7 @@
 require('strict').on()
 
-xp():write_parameter_property(501, 5061, 0x5, xp.pack_signal())
+local topology = xci_ports[1].topology
+
+xp():write_parameter_property(topology.rcc, 5061, 0x5, xp.pack_signal())
 
 return {}
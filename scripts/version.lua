@@ -1,13 +1,18 @@
 require('strict').on()
 
-local function xci_read_software_version(dst_addr, msb_object_id, lsb_object_id)
+local function xci_read_software_version(port, dst_addr, msb_object_id, lsb_object_id)
 	return xp.unpack_software_version(
-		xp():read_user_info(dst_addr, msb_object_id),
-		xp():read_user_info(dst_addr, lsb_object_id));
+		xp(port):read_user_info(dst_addr, msb_object_id),
+		xp(port):read_user_info(dst_addr, lsb_object_id));
 end
 
-return {
-	xtender = xci_read_software_version(101, 3130, 3131),
-	variotrack = xci_read_software_version(301, 11050, 11051),
-	bsp = xci_read_software_version(601, 7037, 7038),
-}
+local versions = {}
+for _, p in ipairs(xci_ports) do
+	versions[p.name] = {
+		xtender = xci_read_software_version(p.name, p.topology.xt, 3130, 3131),
+		variotrack = xci_read_software_version(p.name, p.topology.vt, 11050, 11051),
+		bsp = xci_read_software_version(p.name, p.topology.bsp, 7037, 7038),
+	}
+end
+
+return versions
@@ -1,15 +1,17 @@
 require('strict').on()
 
+local topology = xci_ports[1].topology
+
 local log = require('log')
 
 local before = xp.unpack_le_float(
-		xp():read_parameter_property(101, 1309, 0x5)
+		xp():read_parameter_property(topology.xt, 1309, 0x5)
 		)
 
-xp():write_parameter_property(101, 1309, 0x5, xp.pack_le_float(175)) -- default 180
+xp():write_parameter_property(topology.xt, 1309, 0x5, xp.pack_le_float(175)) -- default 180
 
 local after = xp.unpack_le_float(
-		xp():read_parameter_property(101, 1309, 0x5)
+		xp():read_parameter_property(topology.xt, 1309, 0x5)
 		)
 
 return {
@@ -1,239 +1,224 @@
 require('strict').on()
 
-local metrics = require('metrics')
+local fiber = require('fiber')
+local fio = require('fio')
+local log = require('log')
 
 local http_router = require('http.router').new()
 local http_handler = require('metrics.plugins.prometheus').collect_http
 local http_server = require('http.server').new('0.0.0.0', 8088)
 
-local function xci_metric_callback(self)
+-- poll periods, seconds
+local fast, normal, slow = 0.5, 2, 10
+
+local xci_metric_plan = {
 	-- xtender
-	self.gauge.xt_ubat_min:set(
-		xp.unpack_le_float(
-			xp():read_user_info(101, 3090)
-		))
-	self.gauge.xt_uin:set(
-		xp.unpack_le_float(
-			xp():read_user_info(101, 3113)
-		))
-	self.gauge.xt_iin:set(
-		xp.unpack_le_float(
-			xp():read_user_info(101, 3116)
-		))
-	self.gauge.xt_pout:set(
-		xp.unpack_le_float(
-			xp():read_user_info(101, 3098)
-		))
-	self.gauge.xt_pout_plus:set(
-		xp.unpack_le_float(
-			xp():read_user_info(101, 3097)
-		))
-	self.gauge.xt_fout:set(
-		xp.unpack_le_float(
-			xp():read_user_info(101, 3110)
-		))
-	self.gauge.xt_fin:set(
-		xp.unpack_le_float(
-			xp():read_user_info(101, 3122)
-		))
-	self.gauge.xt_phase:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 3010)
-		))
-	self.gauge.xt_state:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 3049)
-		))
-	self.gauge.xt_mode:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 3028)
-		))
-	self.gauge.xt_transfert:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 3020)
-		))
-	self.gauge.xt_rel_out:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 3030)
-		))
-	self.gauge.xt_rel_gnd:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 3074)
-		))
-	self.gauge.xt_rel_neutral:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 3075)
-		))
-	self.gauge.xt_rme:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 3086)
-		))
-	self.gauge.xt_aux1:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 3031)
-		))
-	self.gauge.xt_aux1_mode:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 3054)
-		))
-	self.gauge.xt_aux2:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 3032)
-		))
-	self.gauge.xt_aux2_mode:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 3055)
-		))
-	self.gauge.xt_ubat:set(
-		xp.unpack_le_float(
-			xp():read_user_info(101, 3092)
-		))
-	self.gauge.xt_ibat:set(
-		xp.unpack_le_float(
-			xp():read_user_info(101, 3095)
-		))
-	self.gauge.xt_pin_a:set(
-		xp.unpack_le_float(
-			xp():read_user_info(101, 3119)
-		))
-	self.gauge.xt_pout_a:set(
-		xp.unpack_le_float(
-			xp():read_user_info(101, 3101)
-		))
-	self.gauge.xt_dev1_plus:set(
-		xp.unpack_le_float(
-			xp():read_user_info(101, 3103)
-		))
+	{ 'xt_ubat_min', 'xt', 3090, fast, },
+	{ 'xt_uin', 'xt', 3113, fast, },
+	{ 'xt_iin', 'xt', 3116, fast, },
+	{ 'xt_pout', 'xt', 3098, fast, },
+	{ 'xt_pout_plus', 'xt', 3097, fast, },
+	{ 'xt_fout', 'xt', 3110, normal, },
+	{ 'xt_fin', 'xt', 3122, normal, },
+	{ 'xt_phase', 'xt', 3010, slow, },
+	{ 'xt_state', 'xt', 3049, slow, },
+	{ 'xt_mode', 'xt', 3028, slow, },
+	{ 'xt_transfert', 'xt', 3020, slow, },
+	{ 'xt_rel_out', 'xt', 3030, slow, },
+	{ 'xt_rel_gnd', 'xt', 3074, slow, },
+	{ 'xt_rel_neutral', 'xt', 3075, slow, },
+	{ 'xt_rme', 'xt', 3086, slow, },
+	{ 'xt_aux1', 'xt', 3031, slow, },
+	{ 'xt_aux1_mode', 'xt', 3054, slow, },
+	{ 'xt_aux2', 'xt', 3032, slow, },
+	{ 'xt_aux2_mode', 'xt', 3055, slow, },
+	{ 'xt_ubat', 'xt', 3092, fast, },
+	{ 'xt_ibat', 'xt', 3095, fast, },
+	{ 'xt_pin_a', 'xt', 3119, fast, },
+	{ 'xt_pout_a', 'xt', 3101, fast, },
+	{ 'xt_dev1_plus', 'xt', 3103, normal, },
 
 	-- variotrack
-	self.gauge.vt_psom:set(
-		xp.unpack_le_float(
-			xp():read_user_info(301, 11043)
-		))
-	self.gauge.vt_state:set(
-		xp.unpack_le16(
-			xp():read_user_info(301, 11069)
-		))
-	self.gauge.vt_mode:set(
-		xp.unpack_le16(
-			xp():read_user_info(301, 11016)
-		))
-	self.gauge.vt_dev1:set(
-		xp.unpack_le_float(
-			xp():read_user_info(301, 11045)
-		))
-	self.gauge.vt_upvm:set(
-		xp.unpack_le_float(
-			xp():read_user_info(301, 11041)
-		))
-	self.gauge.vt_ibam:set(
-		xp.unpack_le_float(
-			xp():read_user_info(301, 11040)
-		))
-	self.gauge.vt_ubam:set(
-		xp.unpack_le_float(
-			xp():read_user_info(301, 11039)
-		))
-	self.gauge.vt_phas:set(
-		xp.unpack_le16(
-			xp():read_user_info(301, 11038)
-		))
-	self.gauge.vt_rme:set(
-		xp.unpack_le16(
-			xp():read_user_info(301, 11082)
-		))
-	self.gauge.vt_aux1:set(
-		xp.unpack_le16(
-			xp():read_user_info(301, 11061)
-		))
-	self.gauge.vt_aux1_mode:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 11063)
-		))
-	self.gauge.vt_aux2:set(
-		xp.unpack_le16(
-			xp():read_user_info(301, 11062)
-		))
-	self.gauge.vt_aux2_mode:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 11064)
-		))
-
-	self.gauge.vt_aux3:set(
-		xp.unpack_le16(
-			xp():read_user_info(301, 11077)
-		))
-	self.gauge.vt_aux3_mode:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 11064)
-		))
-	self.gauge.vt_aux4:set(
-		xp.unpack_le16(
-			xp():read_user_info(301, 11078)
-		))
-	self.gauge.vt_aux4_mode:set(
-		xp.unpack_le16(
-			xp():read_user_info(101, 11080)
-		))
-
+	{ 'vt_psom', 'vt', 11043, fast, },
+	{ 'vt_state', 'vt', 11069, slow, },
+	{ 'vt_mode', 'vt', 11016, slow, },
+	{ 'vt_dev1', 'vt', 11045, normal, },
+	{ 'vt_upvm', 'vt', 11041, fast, },
+	{ 'vt_ibam', 'vt', 11040, fast, },
+	{ 'vt_ubam', 'vt', 11039, fast, },
+	{ 'vt_phas', 'vt', 11038, slow, },
+	{ 'vt_rme', 'vt', 11082, slow, },
+	{ 'vt_aux1', 'vt', 11061, slow, },
+	{ 'vt_aux1_mode', 'xt', 11063, slow, },
+	{ 'vt_aux2', 'vt', 11062, slow, },
+	{ 'vt_aux2_mode', 'xt', 11064, slow, },
+	{ 'vt_aux3', 'vt', 11077, slow, },
+	{ 'vt_aux3_mode', 'xt', 11064, slow, },
+	{ 'vt_aux4', 'vt', 11078, slow, },
+	{ 'vt_aux4_mode', 'xt', 11080, slow, },
 
 	-- bsp
-	self.gauge.bsp_ubat:set(
-		xp.unpack_le_float(
-			xp():read_user_info(601, 7030)
-		))
-	self.gauge.bsp_ibat:set(
-		xp.unpack_le_float(
-			xp():read_user_info(601, 7031)
-		))
-	self.gauge.bsp_soc:set(
-		xp.unpack_le_float(
-			xp():read_user_info(601, 7032)
-		))
-	self.gauge.bsp_tbat:set(
-		xp.unpack_le_float(
-			xp():read_user_info(601, 7033)
-		))
+	{ 'bsp_ubat', 'bsp', 7030, fast, },
+	{ 'bsp_ibat', 'bsp', 7031, fast, },
+	{ 'bsp_soc', 'bsp', 7032, slow, },
+	{ 'bsp_tbat', 'bsp', 7033, slow, },
+}
+
+-- history series of a polled value, created on first use
+local function xci_series_id(port, dst_addr, object_id)
+	local t = box.space.xci_series.index.object:get({ port, dst_addr, object_id, })
+	if t == nil then
+		t = box.space.xci_series:insert({ box.NULL, port, dst_addr, object_id, })
+	end
+	return t.id
 end
 
-local xci_metric = {
-	counter = setmetatable({}, {
-		__index = function(self, k)
-			local cc = rawget(self, k)
-			if cc == nil then
-				cc = metrics.counter('xci_' .. k)
-				self.k = cc
-			end
-			return cc
-		end}),
-	gauge = setmetatable({}, {
-		__index = function(self, k)
-			local gg = rawget(self, k)
-			if gg == nil then
-				gg = metrics.gauge('xci_' .. k)
-				self.k = gg
-			end
-			return gg
-		end}),
-	histogram = setmetatable({}, {
-		__index = function(self, k)
-			local hh = rawget(self, k)
-			if hh == nil then
-				hh = metrics.histogram('xci_' .. k)
-				self.k = hh
+-- plan items name devices by class, the port topology gives their addresses;
+-- items a discovered class lacks (no unit, or an object it does not answer)
+-- are left out
+local function xci_metric_requests(plan, p)
+	local requests = {}
+	for _, m in ipairs(plan) do
+		local found = p.found and p.found[m[2]]
+		if found == nil or (found.objects and found.objects[m[3]]) then
+			local dst_addr = p.topology[m[2]]
+			table.insert(requests, { dst_addr, xp.USER_INFO_OBJECT_TYPE, m[3], 1,
+				period = m[4], metric = m[1],
+				series = xci_series_id(p.name, dst_addr, m[3]), })
+		end
+	end
+	return requests
+end
+
+-- probes the units of every port at once, each bus on its own fiber; the
+-- first unit of a class found replaces the configured address
+local function xci_discover()
+	local fibers = {}
+	for _, p in ipairs(xci_ports) do
+		local f = fiber.new(function() return xp(p.name):discover() end)
+		f:set_joinable(true)
+		fibers[p] = f
+	end
+	for _, p in ipairs(xci_ports) do
+		local ok, found = fibers[p]:join()
+		if ok then
+			p.found = found
+			for class, c in pairs(found) do
+				if c.units[1] then
+					p.topology[class] = c.units[1].dst_addr
+				end
+				for _, u in ipairs(c.units) do
+					log.info('xci: %s %s@%d firmware %s', p.name, class, u.dst_addr,
+						u.version or 'unknown')
+				end
 			end
-			return hh
-		end}),
-}
+		else
+			log.error('xci: discovery on %s failed: %s', p.name, found)
+		end
+	end
+end
 
 return {
 	start = function()
-		metrics.register_callback(
-			setmetatable(xci_metric, {__call = xci_metric_callback})
-			)
+		local blocks = box.space.xci_series_block.id
+		local rollups = box.space.xci_series_rollup.id
+		-- XCI_CAPTURE_DIR keeps the raw traffic of each port in <dir>/<name>.cap
+		local capture_dir = os.getenv('XCI_CAPTURE_DIR')
+		for _, p in ipairs(xci_ports) do
+			if capture_dir then
+				xp(p.name):start_capture(fio.pathjoin(capture_dir, p.name .. '.cap'))
+			end
+		end
+		xci_discover()
+		for _, p in ipairs(xci_ports) do
+			-- parameters are served for 5 min, user infos for a second
+			xp(p.name):set_cache({ parameter = 300, user_info = 1 })
+			xp(p.name):set_history(blocks, rollups)
+			xp(p.name):start_poller(xci_metric_requests(xci_metric_plan, p), normal)
+		end
 
+		-- the open history blocks and buckets live in C until then
+		box.ctl.on_shutdown(function()
+			for _, p in ipairs(xci_ports) do
+				local port = xp.port(p.name)
+				if port ~= nil then
+					port:stop_poller()
+				end
+			end
+		end)
+
+		-- polled values are rendered in C, whatever else the metrics rock
+		-- collects follows them
 		http_server:set_router(http_router)
-		http_router:route({path = '/metrics'}, function(...) return http_handler(...) end)
+		http_router:route({path = '/metrics'}, function(...)
+			local resp = http_handler(...)
+			resp.body = xp.render_metrics() .. resp.body
+			return resp
+		end)
 		http_server:start()
-	end
+	end,
+
+	-- swaps the poll plan of a running instance, e.g. from the console
+	reload = function(plan)
+		for _, p in ipairs(xci_ports) do
+			xp(p.name):reload_poller(xci_metric_requests(plan, p))
+		end
+		xci_metric_plan = plan
+	end,
+
+	-- fetches new and grown datalog files of a port into `dirname`, resuming
+	-- where the local copy ends; returns the bytes held or the error per file
+	sync_datalog = function(dirname, name)
+		local cfg = xci_ports[1]
+		for _, p in ipairs(xci_ports) do
+			if p.name == name then
+				cfg = p
+			end
+		end
+
+		local synced = {}
+		local index = xp(cfg.name):read_datalog_index(cfg.topology.rcc)
+
+		for _, e in ipairs(index) do
+			local path = fio.pathjoin(dirname, e.name)
+			local t = box.space.xci_datalog_sync:get({ cfg.name, e.name })
+			local st = fio.stat(path)
+			local held = st and st.size or 0
+
+			-- unknown or replaced file, a rewrite need not grow it
+			local replaced = t ~= nil and t.mtime ~= e.mtime and e.size <= t.size
+			if t == nil or held > e.size or replaced then
+				held = 0
+			end
+
+			if t == nil or t.size ~= e.size or t.mtime ~= e.mtime or held < e.size then
+				local flags = held > 0 and { 'O_WRONLY', 'O_APPEND', } or
+					{ 'O_WRONLY', 'O_CREAT', 'O_TRUNC', }
+				local f, err = fio.open(path, flags, tonumber('644', 8))
+				local ok = f ~= nil
+				if ok then
+					local port = xp(cfg.name)
+					local rcc = cfg.topology.rcc
+					ok, err = pcall(port.stream_datalog_file, port, rcc, e.name,
+						f.fh, held)
+					f:close()
+				end
+
+				st = fio.stat(path)
+				held = st and st.size or 0
+				box.space.xci_datalog_sync:replace({
+					cfg.name, e.name, e.size, e.mtime, held,
+				})
+
+				if ok then
+					synced[e.name] = held
+				else
+					log.warn('xci: sync %s %s: %s', cfg.name, e.name, err)
+					synced[e.name] = tostring(err)
+				end
+			end
+		end
+
+		return synced
+	end,
 }
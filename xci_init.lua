@@ -33,14 +33,117 @@ box.once('xci_schema', function()
 	})
 end)
 
+box.once('xci_datalog_schema', function()
+	local sd = box.schema.create_space('xci_datalog', { if_not_exists = true, })
+	sd:create_index('pk', { type = 'tree', parts = { 1, 'unsigned', 2, 'unsigned', 3, 'string', }, if_not_exists = true, })
+	sd:format({
+		-- 1 - sample timestamp
+		{ name = 'ts', type = 'unsigned', },
+		-- 2 - user info id
+		{ name = 'object_id', type = 'unsigned', },
+		-- 3 - device instance, e.g. L1-1
+		{ name = 'instance', type = 'string', },
+		-- 4 - sample value
+		{ name = 'value', type = 'number', },
+	})
+end)
+
+box.once('xci_datalog_sync_schema', function()
+	local ss = box.schema.create_space('xci_datalog_sync', { if_not_exists = true, })
+	ss:create_index('pk', { type = 'tree', parts = { 1, 'string', 2, 'string', }, if_not_exists = true, })
+	ss:format({
+		-- 1 - port name
+		{ name = 'port', type = 'string', },
+		-- 2 - datalog file name
+		{ name = 'name', type = 'string', },
+		-- 3 - size in the last directory listing
+		{ name = 'size', type = 'unsigned', },
+		-- 4 - modification time in the last directory listing
+		{ name = 'mtime', type = 'unsigned', },
+		-- 5 - bytes held locally
+		{ name = 'fetched', type = 'unsigned', },
+	})
+end)
+
+box.once('xci_series_schema', function()
+	local se = box.schema.create_space('xci_series', { if_not_exists = true, })
+	se:format({
+		-- 1 - series id
+		{ name = 'id', type = 'unsigned', },
+		-- 2 - port name
+		{ name = 'port', type = 'string', },
+		-- 3 - device address
+		{ name = 'dst_addr', type = 'unsigned', },
+		-- 4 - user info id
+		{ name = 'object_id', type = 'unsigned', },
+	})
+	se:create_index('pk', { type = 'tree', parts = { 1, 'unsigned', }, sequence = true, if_not_exists = true, })
+	se:create_index('object', { type = 'tree', parts = { 2, 'string', 3, 'unsigned', 4, 'unsigned', }, if_not_exists = true, })
+
+	local sb = box.schema.create_space('xci_series_block', { if_not_exists = true, })
+	sb:create_index('pk', { type = 'tree', parts = { 1, 'unsigned', 2, 'unsigned', }, if_not_exists = true, })
+	sb:format({
+		-- 1 - series id
+		{ name = 'series_id', type = 'unsigned', },
+		-- 2 - timestamp of the first sample, ms
+		{ name = 'ts', type = 'unsigned', },
+		-- 3 - number of samples
+		{ name = 'count', type = 'unsigned', },
+		-- 4 - compressed samples, see xcic.decode_series
+		{ name = 'data', type = 'varbinary', },
+	})
+
+	local sr = box.schema.create_space('xci_series_rollup', { if_not_exists = true, })
+	sr:create_index('pk', { type = 'tree', parts = { 1, 'unsigned', 2, 'unsigned', 3, 'unsigned', }, if_not_exists = true, })
+	sr:format({
+		-- 1 - series id
+		{ name = 'series_id', type = 'unsigned', },
+		-- 2 - bucket length, 60 or 3600 s
+		{ name = 'period', type = 'unsigned', },
+		-- 3 - start of the bucket
+		{ name = 'ts', type = 'unsigned', },
+		-- 4 - minimum
+		{ name = 'min', type = 'number', },
+		-- 5 - maximum
+		{ name = 'max', type = 'number', },
+		-- 6 - average
+		{ name = 'avg', type = 'number', },
+		-- 7 - number of samples
+		{ name = 'count', type = 'unsigned', },
+	})
+end)
+
+-- XCI_PORTS=name=path[,name=path...], a single XCI_PORT or /dev/ttyS0 otherwise;
+-- each installation may override the addresses of its devices
+xci_ports = {}
+do
+	local spec = os.getenv('XCI_PORTS') or 'xcom=' .. (os.getenv('XCI_PORT') or '/dev/ttyS0')
+	for name, path in spec:gmatch('([^,=]+)=([^,]+)') do
+		table.insert(xci_ports, {
+			name = name,
+			path = path,
+			topology = { xt = 101, vt = 301, bsp = 601, rcc = 501, },
+		})
+	end
+end
+
 local xcic = require('xcic')
 local xpmt = {
-	__call = function(self)
-		local port = rawget(self, 'port')
+	-- the first port unless named
+	__call = function(self, name)
+		local cfg = name == nil and xci_ports[1] or nil
+		for _, p in ipairs(xci_ports) do
+			if p.name == name then
+				cfg = p
+			end
+		end
+		if cfg == nil then
+			error(string.format('xp: unknown port %s', name), 2)
+		end
+		local port = xcic.port(cfg.name)
 		if port == nil or not port:usable() then
-			port = xcic.open_port('/dev/ttyS0')
-			log.info('xp: reopen (%s)', port)
-			self.port = port
+			port = xcic.open_port(cfg.path, cfg.name)
+			log.info('xp: reopen %s (%s)', cfg.name, port)
 		end
 		return port
 	end
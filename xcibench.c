@@ -0,0 +1,329 @@
+/*
+Copyright (c) 2020 Maxim Galaganov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Frame codec microbenchmarks, no serial port involved.
+ *
+ *   xcibench [-n iterations]
+ *
+ * Prints one JSON object per benchmark and payload size with the time and
+ * the number of slab allocations spent per operation.
+ */
+#include "xcic_codec.h"
+
+#include <scom_data_link.h>
+
+#include <small/quota.h>
+#include <small/slab_arena.h>
+#include <small/slab_cache.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+struct slab *__real_slab_get(struct slab_cache *cache, size_t size);
+struct slab *__wrap_slab_get(struct slab_cache *cache, size_t size);
+
+static uint64_t xcibench_allocs;
+
+/* linked with -Wl,--wrap=slab_get */
+struct slab *__wrap_slab_get(struct slab_cache *cache, size_t size)
+{
+	xcibench_allocs++;
+	return __real_slab_get(cache, size);
+}
+
+static struct slab_cache xcibench_slabc;
+static volatile uint32_t xcibench_sink;
+
+static uint64_t xcibench_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+typedef void (*xcibench_f)(const char *data, size_t data_len);
+
+static void xcibench_run(const char *name, xcibench_f f, const char *data, size_t data_len,
+			 uint64_t iterations)
+{
+	for (uint64_t i = 0; i < iterations / 10 + 1; i++)
+		f(data, data_len);
+
+	uint64_t allocs = xcibench_allocs;
+	uint64_t start = xcibench_now_ns();
+
+	for (uint64_t i = 0; i < iterations; i++)
+		f(data, data_len);
+
+	uint64_t elapsed = xcibench_now_ns() - start;
+	allocs = xcibench_allocs - allocs;
+
+	printf("{\"bench\": \"%s\", \"payload\": %zu, \"iterations\": %" PRIu64
+	       ", \"ns_per_op\": %.2f, \"allocs_per_op\": %.3f}\n",
+	       name, data_len, iterations, (double)elapsed / iterations,
+	       (double)allocs / iterations);
+}
+
+static void xcibench_checksum_xcic(const char *data, size_t data_len)
+{
+	xcibench_sink += xcic_codec_calc_checksum(data, data_len);
+}
+
+/* the checksum of scom_data_link.c, private there */
+static uint16_t xcibench_scom_calc_checksum(const char *data, uint_fast16_t length)
+{
+	uint_fast8_t A = 0xFF, B = 0;
+
+	while (length--) {
+		A = (A + *data++) & 0xFF;
+		B = (B + A) & 0xFF;
+	}
+
+	return (B & 0xFF) << 8 | (A & 0xFF);
+}
+
+static void xcibench_checksum_scomlib(const char *data, size_t data_len)
+{
+	xcibench_sink += xcibench_scom_calc_checksum(data, data_len);
+}
+
+/* mirrors a request encoded by xcic_scom_read_property() */
+static void xcibench_encode(const char *data, size_t data_len, scom_object_type_t object_type,
+			    int write)
+{
+	struct ibuf ibuf;
+	ibuf_create(&ibuf, &xcibench_slabc, 32);
+
+	scom_frame_t frame;
+	scom_initialize_frame(&frame, NULL, 0);
+
+	frame.src_addr = 1;
+	frame.dst_addr = 101;
+
+	scom_property_t property;
+	scom_initialize_property(&property, &frame);
+
+	property.object_type = object_type;
+	property.object_id = 3000;
+	property.property_id = 1;
+
+	if (write)
+		(void)xcic_codec_encode_write_property(&ibuf, &property, data, data_len);
+	else
+		(void)xcic_codec_encode_read_property(&ibuf, &property, data, data_len);
+
+	(void)xcic_codec_encode_request_frame(&ibuf, &frame);
+
+	xcibench_sink += (uint8_t)frame.buffer[scom_frame_length(&frame) - 1];
+
+	ibuf_destroy(&ibuf);
+}
+
+static void xcibench_encode_read(const char *data, size_t data_len)
+{
+	xcibench_encode(data, data_len, SCOM_USER_INFO_OBJECT_TYPE, 0);
+}
+
+static void xcibench_encode_write(const char *data, size_t data_len)
+{
+	xcibench_encode(data, data_len, SCOM_PARAMETER_OBJECT_TYPE, 1);
+}
+
+static void xcibench_encode_datalog(const char *data, size_t data_len)
+{
+	xcibench_encode(data, data_len, (scom_object_type_t)0x101, 0);
+}
+
+/* mirrors xcic_scom_read_property() on the buffer a port keeps across requests */
+static struct ibuf xcibench_port_ibuf;
+
+static void xcibench_encode_read_reused(const char *data, size_t data_len)
+{
+	ibuf_reset(&xcibench_port_ibuf);
+
+	scom_frame_t frame;
+	scom_initialize_frame(&frame, NULL, 0);
+
+	frame.src_addr = 1;
+	frame.dst_addr = 101;
+
+	scom_property_t property;
+	scom_initialize_property(&property, &frame);
+
+	property.object_type = SCOM_USER_INFO_OBJECT_TYPE;
+	property.object_id = 3000;
+	property.property_id = 1;
+
+	(void)xcic_codec_encode_read_property(&xcibench_port_ibuf, &property, data, data_len);
+	(void)xcic_codec_encode_request_frame(&xcibench_port_ibuf, &frame);
+
+	xcibench_sink += (uint8_t)frame.buffer[scom_frame_length(&frame) - 1];
+}
+
+/* the one-off cost of a prepared request, the poller pays it per plan load */
+static void xcibench_prepare_read(const char *data, size_t data_len)
+{
+	(void)data;
+	(void)data_len;
+
+	struct xcic_request request = {
+	    .dst_addr = 101,
+	    .object_type = SCOM_USER_INFO_OBJECT_TYPE,
+	    .object_id = 3000,
+	    .property_id = 1,
+	};
+
+	(void)xcic_codec_prepare_read_property(&request);
+
+	xcibench_sink += (uint8_t)request.frame[request.length - 1];
+}
+
+static char xcibench_response[1024];
+static size_t xcibench_response_len;
+
+/* builds a read property response carrying `data_len` bytes of value */
+static size_t xcibench_prepare_response(const char *data, size_t data_len)
+{
+	scom_frame_t frame;
+	scom_initialize_frame(&frame, xcibench_response, sizeof(xcibench_response));
+
+	frame.src_addr = 101;
+	frame.dst_addr = 1;
+
+	scom_property_t property;
+	scom_initialize_property(&property, &frame);
+
+	property.object_type = SCOM_USER_INFO_OBJECT_TYPE;
+	property.object_id = 3000;
+	property.property_id = 1;
+
+	scom_encode_read_property(&property);
+	memcpy(property.value_buffer, data, data_len);
+	frame.data_length += data_len;
+
+	scom_encode_request_frame(&frame);
+
+	frame.buffer[SCOM_FRAME_HEADER_SIZE] = 0x2; /* is_response */
+	scom_write_le16(&frame.buffer[SCOM_FRAME_HEADER_SIZE + frame.data_length],
+			xcic_codec_calc_checksum(&frame.buffer[SCOM_FRAME_HEADER_SIZE],
+						 frame.data_length));
+
+	return scom_frame_length(&frame);
+}
+
+/* mirrors a response decoded by xcic_scom_port_exchange() and xcic_scom_read_property() */
+static void xcibench_decode(const char *data, size_t data_len)
+{
+	(void)data;
+	(void)data_len;
+
+	scom_frame_t frame;
+	scom_initialize_frame(&frame, xcibench_response, xcibench_response_len);
+
+	scom_decode_frame_header(&frame);
+	scom_decode_frame_data(&frame);
+
+	scom_property_t property;
+	scom_initialize_property(&property, &frame);
+
+	scom_decode_read_property(&property);
+
+	xcibench_sink += property.value_length + frame.last_error;
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t iterations = 1000000;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "Usage: xcibench [-n iterations]\n");
+			return 1;
+		}
+	}
+
+	struct quota quota;
+	struct slab_arena arena;
+
+	quota_init(&quota, QUOTA_MAX);
+	if (slab_arena_create(&arena, &quota, 0, 1 << 16, MAP_PRIVATE)) {
+		fprintf(stderr, "xcibench: slab_arena_create failed\n");
+		return 1;
+	}
+	slab_cache_create(&xcibench_slabc, &arena);
+
+	static char payload[1024];
+	for (size_t i = 0; i < sizeof(payload); i++)
+		payload[i] = (char)(i * 31 + 7);
+
+	static const size_t checksum_sizes[] = {12, 14, 28, 266, 1000};
+	for (size_t i = 0; i < SCOM_NBR_ELEMENTS(checksum_sizes); i++) {
+		xcibench_run("checksum_xcic", xcibench_checksum_xcic, payload, checksum_sizes[i],
+			     iterations);
+		xcibench_run("checksum_scomlib", xcibench_checksum_scomlib, payload,
+			     checksum_sizes[i], iterations);
+	}
+
+	xcibench_run("encode_read", xcibench_encode_read, payload, 0, iterations);
+
+	ibuf_create(&xcibench_port_ibuf, &xcibench_slabc, 512);
+	xcibench_run("encode_read_reused", xcibench_encode_read_reused, payload, 0, iterations);
+	ibuf_destroy(&xcibench_port_ibuf);
+
+	xcibench_run("prepare_read", xcibench_prepare_read, payload, 0, iterations);
+
+	static const size_t write_sizes[] = {1, 2, 4};
+	for (size_t i = 0; i < SCOM_NBR_ELEMENTS(write_sizes); i++)
+		xcibench_run("encode_write", xcibench_encode_write, payload, write_sizes[i],
+			     iterations);
+
+	xcibench_run("encode_datalog_start", xcibench_encode_datalog, "LG200921.CSV", 12,
+		     iterations);
+
+	/* user info, message, datalog blocks */
+	static const size_t response_sizes[] = {4, 18, 64, 256, 980};
+	static const char *response_names[] = {"decode_read", "decode_message",
+					       "decode_datalog_block", "decode_datalog_block",
+					       "decode_datalog_block"};
+	for (size_t i = 0; i < SCOM_NBR_ELEMENTS(response_sizes); i++) {
+		xcibench_response_len = xcibench_prepare_response(payload, response_sizes[i]);
+		xcibench_run(response_names[i], xcibench_decode, payload, response_sizes[i],
+			     iterations);
+	}
+
+	slab_cache_destroy(&xcibench_slabc);
+	slab_arena_destroy(&arena);
+
+	return 0;
+}
@@ -21,6 +21,8 @@ SOFTWARE.
 */
 #include <tarantool/module.h>
 
+#include <msgpuck.h>
+
 #include <lauxlib.h>
 #include <lua.h>
 #include <lualib.h>
@@ -28,19 +30,43 @@ SOFTWARE.
 #include <small/small.h>
 #include <small/static.h>
 #include <small/ibuf.h>
+#include <small/rlist.h>
 
 #include <scom_property.h>
 
+#include "xcic_capture.h"
+#include "xcic_codec.h"
+#include "xcic_datalog.h"
+#include "xcic_series.h"
+
 #include <unistd.h>
 #include <fcntl.h>
 #include <termios.h>
+#include <dirent.h>
+#include <limits.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
 
 #define XCIC_PORT_LUA_UDATA_NAME "__tnt_xcic_port"
+#define XCIC_SUBSCRIPTION_LUA_UDATA_NAME "__tnt_xcic_subscription"
+#define XCIC_REQUEST_LUA_UDATA_NAME "__tnt_xcic_request"
 
 LUA_API int luaopen_xcic(lua_State *L);
 
 static int xcic_open_port(lua_State *L);
 static int xcic_calc_checksum(lua_State *L);
+static int xcic_prepare_read(lua_State *L);
+static int xcic_port(lua_State *L);
+static int xcic_ports(lua_State *L);
+static int xcic_merged_snapshot(lua_State *L);
+static int xcic_load_datalog(lua_State *L);
+static int xcic_message_text(lua_State *L);
+static int xcic_decode_series(lua_State *L);
+static int xcic_render_metrics(lua_State *L);
+static int xcic_load_datalog_dir(lua_State *L);
 
 static int xcic_pack_le32(lua_State *L);
 static int xcic_unpack_le32(lua_State *L);
@@ -55,30 +81,525 @@ static int xcic_unpack_software_version(lua_State *L);
 
 static int xcic_port_close(lua_State *L);
 static int xcic_port_usable(lua_State *L);
+static int xcic_port_set_timeouts(lua_State *L);
+static int xcic_port_get_timeouts(lua_State *L);
+static int xcic_port_set_history(lua_State *L);
+static int xcic_port_start_capture(lua_State *L);
+static int xcic_port_stop_capture(lua_State *L);
+static int xcic_port_stats(lua_State *L);
+static int xcic_port_set_frame_ring(lua_State *L);
+static int xcic_port_set_cache(lua_State *L);
+static int xcic_port_frames(lua_State *L);
 static int xcic_port_to_string(lua_State *L);
 static int xcic_port_gc(lua_State *L);
 static int xcic_port_read_user_info(lua_State *L);
 static int xcic_port_read_parameter_property(lua_State *L);
+static int xcic_port_read_user_info_typed(lua_State *L);
+static int xcic_port_read_parameter_typed(lua_State *L);
+static int xcic_port_read_many(lua_State *L);
+static int xcic_port_read_prepared(lua_State *L);
+static int xcic_port_set_fleet(lua_State *L);
+static int xcic_port_get_fleet(lua_State *L);
+static int xcic_port_read_fleet(lua_State *L);
+static int xcic_port_discover(lua_State *L);
 static int xcic_port_write_parameter_property(lua_State *L);
 static int xcic_port_read_message(lua_State *L);
+static int xcic_port_sync_messages(lua_State *L);
 static int xcic_port_read_datalog_dir(lua_State *L);
 static int xcic_port_read_datalog_file(lua_State *L);
+static int xcic_port_stream_datalog_file(lua_State *L);
+static int xcic_port_read_datalog_index(lua_State *L);
+static int xcic_port_start_poller(lua_State *L);
+static int xcic_port_stop_poller(lua_State *L);
+static int xcic_port_reload_poller(lua_State *L);
+static int xcic_port_snapshot(lua_State *L);
+static int xcic_port_subscribe(lua_State *L);
+
+static int xcic_subscription_get(lua_State *L);
+static int xcic_subscription_count(lua_State *L);
+static int xcic_subscription_dropped(lua_State *L);
+static int xcic_subscription_is_closed(lua_State *L);
+static int xcic_subscription_close(lua_State *L);
+static int xcic_subscription_gc(lua_State *L);
+
+#define XCIC_RESPONSE_TIMEOUT 2.0
+#define XCIC_BYTE_TIMEOUT 0.1
+
+/** First byte of every frame, see scom_data_link.c */
+#define XCIC_FRAME_START_BYTE 0xAA
+/** Larger frames are taken for garbage that happens to pass the header checksum. */
+#define XCIC_FRAME_DATA_SIZE_MAX 1024
+/** Time the largest frame takes on the line at 38400 baud, 10 bits a byte. */
+#define XCIC_FRAME_TIME_MAX ((SCOM_FRAME_HEADER_SIZE + XCIC_FRAME_DATA_SIZE_MAX + 2) * 10 / 38400.0)
+
+#define XCIC_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+#define XCIC_VALUE_SIZE_MAX 16
+#define XCIC_ERRMSG_SIZE_MAX 96
+
+/** Tuples per transaction when loading datalog files. */
+#define XCIC_DATALOG_BATCH 1000
+#define XCIC_DATALOG_WORKERS_MAX 16
+
+/** Oldest history tuples dropped per write, keeps pruning incremental. */
+#define XCIC_HISTORY_PRUNE_MAX 4
+
+/** Message logs of distinct devices a port keeps track of. */
+#define XCIC_MESSAGE_SOURCES_MAX 8
+
+/** Attempts at a datalog block before the transfer is given up. */
+#define XCIC_XFER_RETRIES 5
+
+/** Distinct (dst_addr, object_type) latencies and error codes tracked per port. */
+#define XCIC_STATS_LATENCY_MAX 32
+#define XCIC_STATS_ERRORS_MAX 32
+
+/** Exchanges kept in the frame ring of a port unless resized. */
+#define XCIC_RING_SIZE_DEFAULT 32
+/** Bytes kept of each frame, enough for all but datalog blocks. */
+#define XCIC_RING_FRAME_SIZE 256
+
+/** Captured bytes are written out once this many are buffered or a second has passed. */
+#define XCIC_CAPTURE_FLUSH_SIZE 32768
+#define XCIC_CAPTURE_FLUSH_INTERVAL 1.0
+
+/** Device classes and the address ranges their units take on the bus. */
+#define XCIC_DEVICE_CLASS_COUNT 5
+
+static const struct xcic_device_class {
+	const char *name;
+	uint32_t first_addr;
+	uint32_t last_addr;
+	/** User infos holding the firmware version, 0 if the class is not probed. */
+	uint32_t version_msb;
+	uint32_t version_lsb;
+} xcic_device_classes[XCIC_DEVICE_CLASS_COUNT] = {
+    {"xt", 101, 109, 3130, 3131},
+    {"vt", 301, 315, 11050, 11051},
+    {"vs", 701, 715, 0, 0},
+    {"bsp", 601, 601, 7037, 7038},
+    {"rcc", 501, 501, 0, 0},
+};
+
+/** Short retries of a probe answered with gateway_busy. */
+#define XCIC_PROBE_RETRIES 3
+
+/** Known object and the wire format of its value. */
+struct xcic_object {
+	scom_object_type_t object_type;
+	uint32_t object_id;
+	scom_format_t format;
+	const char *name;
+};
+
+/** An entry of the message log of a device. */
+struct xcic_message {
+	/** Number of messages in the log. */
+	uint32_t count;
+	uint16_t type;
+	uint32_t src_addr;
+	uint32_t ts;
+	uint32_t value;
+};
+
+/** How far the message log of a device has been read. */
+struct xcic_message_cursor {
+	uint32_t dst_addr;
+	/** Log length at the last sync, 0 if never synced. */
+	uint32_t count;
+	/** Newest message stored. */
+	struct xcic_message last;
+};
+
+/** Tiers of the history: raw blocks, then 1 min and 1 h rollups. */
+enum xcic_history_tier {
+	XCIC_HISTORY_RAW,
+	XCIC_HISTORY_MINUTE,
+	XCIC_HISTORY_HOUR,
+	XCIC_HISTORY_TIER_MAX,
+};
+
+/** Where and for how long a port keeps the history of its polled values. */
+struct xcic_history {
+	/** Blocks [series_id, ts (ms), count, data]. */
+	uint32_t block_space_id;
+	/** Rollups [series_id, period, ts, min, max, avg, count]. */
+	uint32_t rollup_space_id;
+	/** Retention of each tier, s. */
+	double retention[XCIC_HISTORY_TIER_MAX];
+};
+
+/** Block being filled and buckets being accounted for one polled value. */
+struct xcic_series {
+	struct xcic_series_block block;
+	struct xcic_series_rollup rollups[XCIC_HISTORY_TIER_MAX - 1];
+};
+
+/** Classes of requests sharing a port, served in this order. */
+enum xcic_priority {
+	/** Writes of parameters. */
+	XCIC_PRIORITY_CONTROL,
+	/** Reads on behalf of a caller waiting for them. */
+	XCIC_PRIORITY_INTERACTIVE,
+	/** Reads of the background poller. */
+	XCIC_PRIORITY_POLL,
+	/** Datalog transfers, they give way between blocks. */
+	XCIC_PRIORITY_BULK,
+	XCIC_PRIORITY_MAX,
+};
+
+static const char *const xcic_priority_names[] = {"control", "interactive", "poll", "bulk"};
+
+/** A fiber waiting for its turn on a port. */
+struct xcic_queue_waiter {
+	struct rlist link;
+	struct fiber *fiber;
+	/** Set by the fiber handing the port over. */
+	bool granted;
+};
+
+/** A value read recently, keyed by the object tuple. */
+struct xcic_cache_entry {
+	uint32_t dst_addr;
+	scom_object_type_t object_type;
+	uint32_t object_id;
+	uint16_t property_id;
+	/** Monotonic time of the read, 0 for an empty slot. */
+	double ts;
+	size_t value_length;
+	char value[XCIC_VALUE_SIZE_MAX];
+};
+
+/** Values of reads served again within their time to live, direct-mapped. */
+struct xcic_cache {
+	/** Time to live of user infos and parameters, s; other types are not cached. */
+	double user_info_ttl;
+	double parameter_ttl;
+	size_t size;
+	struct xcic_cache_entry entries[];
+};
+
+/** A read on the wire that later identical reads wait for instead of repeating it. */
+struct xcic_flight {
+	/** Link in xcic_port::flights. */
+	struct rlist link;
+	uint32_t dst_addr;
+	scom_object_type_t object_type;
+	uint32_t object_id;
+	uint16_t property_id;
+	/** Class the leader queues in, only callers of that class or below join. */
+	enum xcic_priority priority;
+	/** Fibers waiting for the result, linked by xcic_queue_waiter::link. */
+	struct rlist followers;
+	/** Followers yet to copy the result, the leader waits for them to finish. */
+	size_t pending;
+	struct fiber *leader;
+	/** The result, valid once the followers are granted. */
+	scom_error_t error;
+	const char *value;
+	size_t value_length;
+	char errmsg[256];
+};
+
+/** How a priority class fares in the queue of a port. */
+struct xcic_queue_stats {
+	/** Fibers waiting now and at most. */
+	uint64_t depth;
+	uint64_t depth_max;
+	/** Turns taken, and how many of them had to wait. */
+	uint64_t acquired;
+	uint64_t waits;
+	/** Time spent waiting in total and at most. */
+	double wait;
+	double wait_max;
+};
+
+/** Upper bounds of the request latency buckets, s; one more bucket takes the rest. */
+static const double xcic_stats_buckets[] = {0.005, 0.01, 0.02, 0.05, 0.1, 0.2, 0.5, 1, 2, 5};
+
+#define XCIC_STATS_BUCKET_COUNT (SCOM_NBR_ELEMENTS(xcic_stats_buckets) + 1)
+
+/** Round trips of the requests of one object type to one device. */
+struct xcic_stats_latency {
+	uint32_t dst_addr;
+	scom_object_type_t object_type;
+	uint64_t count;
+	double sum;
+	uint64_t buckets[XCIC_STATS_BUCKET_COUNT];
+};
+
+struct xcic_stats_error {
+	scom_error_t code;
+	uint64_t count;
+};
+
+/** Counters of a port, all kept in place so that accounting never allocates. */
+struct xcic_port_stats {
+	/** Exchanges attempted. */
+	uint64_t requests;
+	/** Reads served by sharing the result of an identical read in flight. */
+	uint64_t coalesced;
+	/** Reads looked up in the cache while enabled, and the ones served from it. */
+	uint64_t cache_lookups;
+	uint64_t cache_hits;
+	uint64_t bytes_out;
+	uint64_t bytes_in;
+	/** Frames failing the header or the data checksum. */
+	uint64_t checksum_errors;
+	uint64_t reopens;
+	struct xcic_queue_stats queue[XCIC_PRIORITY_MAX];
+	/** Exchanges of pairs beyond XCIC_STATS_LATENCY_MAX, not broken down. */
+	uint64_t latency_untracked;
+	size_t latency_count;
+	struct xcic_stats_latency latencies[XCIC_STATS_LATENCY_MAX];
+	size_t error_count;
+	struct xcic_stats_error errors[XCIC_STATS_ERRORS_MAX];
+};
+
+/** A request and its response as they went over the wire. */
+struct xcic_ring_slot {
+	/** Realtime timestamp of the request. */
+	double ts;
+	/** Time to the response, 0 if none came. */
+	double latency;
+	/** Error of the exchange, SCOM_ERROR_NO_ERROR if a response was received. */
+	scom_error_t error;
+	/** Lengths on the wire, the bytes kept are cut at XCIC_RING_FRAME_SIZE. */
+	uint16_t request_length;
+	uint16_t response_length;
+	char request[XCIC_RING_FRAME_SIZE];
+	char response[XCIC_RING_FRAME_SIZE];
+};
+
+/** The last exchanges of a port, recorded as raw bytes and decoded on demand. */
+struct xcic_ring {
+	size_t size;
+	/** Exchanges recorded so far, the next slot is `count % size`. */
+	uint64_t count;
+	struct xcic_ring_slot slots[];
+};
+
+/** Raw traffic of a port being written to a set of rotated files. */
+struct xcic_capture {
+	/** The current file, older ones are suffixed with .1, .2 and so on. */
+	char *pathname;
+	int fd;
+	/** Bytes written to the current file. */
+	size_t size;
+	/** The file is rotated once it grows past this size. */
+	size_t size_max;
+	/** Number of files kept, the current one included. */
+	int files;
+	/** Records not written out yet. */
+	struct ibuf buf;
+	/** Records being written out by a coio thread, swapped with `buf`. */
+	struct ibuf out;
+	/** errno of the last failed write, set in the coio thread. */
+	int error;
+	/** Records lost to failed writes. */
+	uint64_t dropped;
+	/** Writes `buf` out every flush interval, frees the capture once stopping. */
+	struct fiber *fiber;
+	struct fiber_cond *cond;
+	bool stopping;
+};
+
+/** Polled object along with the outcome of its most recent read. */
+struct xcic_poll_entry {
+	uint32_t dst_addr;
+	scom_object_type_t object_type;
+	uint32_t object_id;
+	uint16_t property_id;
+	/** Catalog entry used to decode the value, NULL if unknown. */
+	const struct xcic_object *object;
+	/** The request frame, encoded when the plan is loaded. */
+	struct xcic_request request;
+	/** Response timeout of this entry, 0 for the port default. */
+	double timeout;
+	/** Desired time between two reads. */
+	double period;
+	/** Tie breaker between equal deadlines, lower is served first. */
+	int priority;
+	/** Monotonic time the entry becomes due; its deadline is one period later. */
+	double due;
+	/** Number of reads completed past their deadline. */
+	uint64_t missed;
+	/** History series the values go to, 0 if not recorded. */
+	uint32_t series_id;
+	struct xcic_series *series;
+	/** Prometheus sample name with labels, NULL if not exported. */
+	char *metric;
+	/** Length of the metric family name that `metric` starts with. */
+	size_t family_length;
+	/** Value bytes of the last successful read. */
+	char value[XCIC_VALUE_SIZE_MAX];
+	size_t value_length;
+	/** Realtime timestamp of the last successful read. */
+	double ts;
+	/** Number of successful reads, zero until the first value arrives. */
+	uint64_t version;
+	/** Error of the last read attempt or SCOM_ERROR_NO_ERROR. */
+	scom_error_t last_error;
+	char last_errmsg[XCIC_ERRMSG_SIZE_MAX];
+};
+
+/** Background fiber walking the poll list and publishing a snapshot. */
+struct xcic_poller {
+	struct fiber *fiber;
+	/** Coroutine used to collect error messages of the helpers. */
+	lua_State *L;
+	int L_ref;
+	/** Keeps the port userdata alive while the fiber runs. */
+	int port_ref;
+	/** Period of the entries that do not specify one. */
+	double interval;
+	/** Number of completed reads. */
+	uint64_t generation;
+	/** Realtime timestamp of the last completed read. */
+	double ts;
+	/** Number of reads completed past their deadline, all entries. */
+	uint64_t missed;
+	/** Bumped whenever the entries are replaced. */
+	uint64_t plan_version;
+	/** Set while the fiber waits for the next entry to become due. */
+	bool idle;
+	size_t entry_count;
+	struct xcic_poll_entry *entries;
+};
 
 /** Xcom-232i serial port handle. */
 struct xcic_port {
 	/** The file descriptor of the opened serial port. */
 	int fd;
-	/** Latch for mutual exclusion of DTE exchanges. */
-	box_latch_t *latch;
+	/** Path used to (re)open the serial port, NULL once closed. */
+	char *pathname;
+	/** Registry name, NULL for an anonymous port. */
+	char *name;
+	/** Link in xcic_port_registry while registered. */
+	struct rlist link;
+	/** Keeps a registered port alive until it is closed. */
+	int self_ref;
+	/** Set while a fiber holds the port for DTE exchanges. */
+	bool busy;
+	/** Priority the port is held with. */
+	enum xcic_priority holder;
+	/** Fibers waiting for the port by priority, linked by xcic_queue_waiter::link. */
+	struct rlist waiters[XCIC_PRIORITY_MAX];
+	/** Reads in progress, linked by xcic_flight::link. */
+	struct rlist flights;
+	/** Frame buffer of the exchanges, used by the holder and never shrunk. */
+	struct ibuf ibuf;
+	/** Bytes received but not parsed yet, the response is hunted for in here. */
+	struct ibuf rx;
+	/** Bytes skipped while hunting for a valid frame. */
+	uint64_t rx_skipped;
+	/** Well-formed frames dropped for not answering the request. */
+	uint64_t rx_dropped;
+	/** Realtime timestamp of the last byte received. */
+	double rx_ts;
+	/** Default time to wait for the first byte of a response. */
+	double response_timeout;
+	/** Time to wait for each next byte once a response is flowing. */
+	double byte_timeout;
+	/** Response timeout of the next exchange only, set by the holder; 0 for default. */
+	double timeout;
+	/** Background poller, NULL unless started. */
+	struct xcic_poller *poller;
+	/** Subscriptions fed by the poller, linked by xcic_subscription::link. */
+	struct rlist subscriptions;
+	/** Message logs synced through this port. */
+	struct xcic_message_cursor cursors[XCIC_MESSAGE_SOURCES_MAX];
+	/** History of the polled values, NULL unless enabled. */
+	struct xcic_history *history;
+	/** Capture of the raw traffic, NULL unless started. */
+	struct xcic_capture *capture;
+	struct xcic_port_stats stats;
+	/** Recent exchanges, NULL if disabled. */
+	struct xcic_ring *ring;
+	/** Recently read values, NULL unless enabled. */
+	struct xcic_cache *cache;
+	/** Units present per device class, bit 0 for the first address. */
+	uint32_t fleet[XCIC_DEVICE_CLASS_COUNT];
+	/** Classes whose units are known, bit per class; the others span their range. */
+	uint32_t fleet_known;
+};
+
+/** A change of a polled value as queued for subscribers. */
+struct xcic_event {
+	char value[XCIC_VALUE_SIZE_MAX];
+	size_t value_length;
+	double ts;
+	uint64_t version;
+	uint16_t error;
+	char errmsg[XCIC_ERRMSG_SIZE_MAX];
+};
+
+struct xcic_subscription {
+	struct rlist link;
+	/** The port this subscription is registered with, NULL once closed. */
+	struct xcic_port *xp;
+	/** Keeps the port userdata alive while subscribed. */
+	int port_ref;
+	uint16_t dst_addr;
+	scom_object_type_t object_type;
+	uint32_t object_id;
+	uint16_t property_id;
+	const struct xcic_object *object;
+	/** Minimal change of a float value worth an event. */
+	double deadband;
+	/** Last delivered value, the reference for the deadband. */
+	char value[XCIC_VALUE_SIZE_MAX];
+	size_t value_length;
+	/** Last delivered error, SCOM_ERROR_NO_ERROR after a value. */
+	uint16_t error;
+	/** Bounded queue of events, the oldest one is dropped on overflow. */
+	struct xcic_event *events;
+	size_t capacity;
+	size_t head;
+	size_t count;
+	uint64_t dropped;
+	/** Signalled on every new event and on close. */
+	struct fiber_cond *cond;
+};
+
+/** Datalog files of a directory, shared by the worker fibers loading them. */
+struct xcic_datalog_job {
+	uint32_t space_id;
+	const char *dirname;
+	char **names;
+	size_t count;
+	/** The next file to take. */
+	size_t next;
+	/** Per file: tuples stored, or -1 with the reason in `errmsgs`. */
+	ssize_t *stored;
+	char (*errmsgs)[XCIC_ERRMSG_SIZE_MAX];
+};
+
+/** Where the blocks of a datalog transfer go, one of the three. */
+struct xcic_xfer_sink {
+	/** Accumulates the whole transfer. */
+	struct ibuf *ibuf;
+	/** Gets every block written as it arrives, -1 if unused. */
+	int fd;
+	/** Stack index of a Lua function called with every block, 0 if unused. */
+	int callback;
+	/** Bytes of the file received so far. */
+	size_t length;
+	/** Bytes the sink already holds from an earlier transfer, not delivered again. */
+	size_t offset;
 };
 
 static int xcic_scom_read_property(lua_State *L, struct xcic_port *xp, struct ibuf *ibuf,
 				   scom_property_t *property, const char *data, size_t data_len);
 static int xcic_scom_write_property(lua_State *L, struct xcic_port *xp, struct ibuf *ibuf,
 				    scom_property_t *property, const char *data, size_t data_len);
+static int xcic_scom_read_prepared(lua_State *L, struct xcic_port *xp, struct ibuf *ibuf,
+				   const struct xcic_request *request, scom_property_t *property);
+static int xcic_scom_read_response(lua_State *L, struct xcic_port *xp, struct ibuf *ibuf,
+				   scom_property_t *property, uint32_t object_id);
 static int xcic_scom_xfer_datalog(lua_State *L, struct xcic_port *xp, uint32_t dst_addr,
 				  uint32_t object_id, const char *data, size_t data_len,
-				  struct ibuf *rbuf);
+				  struct xcic_xfer_sink *sink);
 static int xcic_scom_port_exchange(lua_State *L, struct xcic_port *xp, struct ibuf *ibuf,
 				   scom_frame_t *frame);
 
@@ -94,17 +615,117 @@ static int xcic_scom_decode_frame_data(lua_State *L, scom_frame_t *frame);
 static int xcic_scom_decode_read_property(lua_State *L, scom_property_t *property);
 static int xcic_scom_decode_write_property(lua_State *L, scom_property_t *property);
 
-static uint16_t xcic_scom_calc_checksum(const char *data, uint_fast16_t length);
 static void xcic_scom_dump_faulty_frame(struct ibuf *ibuf, scom_frame_t *frame);
-static char *xcic_scom_strerror(scom_error_t error);
 
-static ssize_t xcic_intl_port_read(struct xcic_port *xp, void *buf, size_t count);
-static ssize_t xcic_intl_port_write(struct xcic_port *xp, void *buf, size_t count);
+static ssize_t xcic_intl_port_recv_frame(struct xcic_port *xp, uint32_t src_addr, double timeout);
+static ssize_t xcic_intl_port_write(struct xcic_port *xp, void *buf, size_t count,
+				    double timeout);
 
+static int xcic_intl_port_open(lua_State *L, struct xcic_port *xp, const char *pathname);
 static void xcic_intl_port_close(struct xcic_port *xp);
+static void xcic_intl_capture(struct xcic_port *xp, enum xcic_capture_kind kind,
+			      const void *data, size_t len);
+static int xcic_intl_capture_open(struct xcic_capture *capture);
+static ssize_t xcic_intl_capture_write_cb(va_list ap);
+static int xcic_intl_capture_f(va_list ap);
+static void xcic_intl_capture_free(struct xcic_capture *capture);
+static void xcic_intl_capture_delete(struct xcic_capture *capture);
+static void xcic_intl_port_lock(struct xcic_port *xp, enum xcic_priority priority);
+static void xcic_intl_port_unlock(struct xcic_port *xp);
+static void xcic_intl_port_yield(struct xcic_port *xp);
+static int xcic_intl_read_shared(lua_State *L, struct xcic_port *xp, enum xcic_priority priority,
+				 double timeout, double max_age, const struct xcic_request *request,
+				 scom_property_t *property, char *value);
+static struct xcic_cache_entry *xcic_intl_cache_slot(struct xcic_cache *cache,
+						     uint32_t dst_addr,
+						     scom_object_type_t object_type,
+						     uint32_t object_id, uint16_t property_id);
+static void xcic_intl_cache_invalidate(struct xcic_cache *cache, uint32_t dst_addr,
+				       scom_object_type_t object_type, uint32_t object_id);
+static void xcic_intl_stats_latency(struct xcic_port *xp, uint32_t dst_addr,
+				    scom_object_type_t object_type, double latency);
+static void xcic_intl_stats_error(struct xcic_port *xp, scom_error_t code);
+static int xcic_intl_stats_render(struct ibuf *buf);
+static struct xcic_ring *xcic_intl_ring_new(size_t size);
+static struct xcic_ring_slot *xcic_intl_ring_record(struct xcic_port *xp, const char *request,
+						    size_t length);
+static void xcic_intl_ring_frame_push(lua_State *L, const char *frame, size_t wire_length);
+static int xcic_intl_datalog_store(uint32_t space_id, const struct xcic_datalog *log,
+				   char *errmsg, size_t errmsg_size);
+static ssize_t xcic_intl_datalog_parse_cb(va_list ap);
+static ssize_t xcic_intl_datalog_parse_file_cb(va_list ap);
+static ssize_t xcic_intl_datalog_list_cb(va_list ap);
+static int xcic_intl_datalog_worker_f(va_list ap);
+static int xcic_intl_xfer_sink_put(lua_State *L, struct xcic_xfer_sink *sink, const char *data,
+				   size_t data_len);
 
 static ssize_t xcic_intl_open_cb(va_list ap);
 
+static int xcic_intl_message_read(lua_State *L, struct xcic_port *xp, uint32_t dst_addr,
+				  uint32_t index, struct xcic_message *message);
+static struct xcic_message_cursor *xcic_intl_message_cursor(struct xcic_port *xp,
+							    uint32_t dst_addr);
+static int xcic_intl_messages_store(uint32_t space_id, const struct xcic_message *messages,
+				    size_t count, char *errmsg, size_t errmsg_size);
+static const char *xcic_intl_message_text(uint16_t type);
+
+static int xcic_intl_device_class_find(const char *name);
+static scom_error_t xcic_intl_probe(lua_State *L, struct xcic_port *xp, uint32_t dst_addr,
+				    uint32_t object_id, double timeout, char *value);
+static bool xcic_intl_probe_answered(scom_error_t error);
+static scom_error_t xcic_intl_probe_objects(lua_State *L, struct xcic_port *xp,
+					    const struct xcic_device_class *dc, uint32_t dst_addr,
+					    double timeout);
+static const struct xcic_object *xcic_intl_object_find(scom_object_type_t object_type,
+							uint32_t object_id);
+static int xcic_intl_object_check(lua_State *L, const struct xcic_object *object,
+				  size_t value_length);
+static void xcic_intl_object_push(lua_State *L, const struct xcic_object *object,
+				  const char *value);
+
+static int xcic_intl_poll_list_parse(lua_State *L, int idx, const char *port_name,
+				     double period, struct xcic_poll_entry **entries,
+				     size_t *entry_count);
+static void xcic_intl_poll_list_free(struct xcic_poll_entry *entries, size_t entry_count);
+static char *xcic_intl_metric_name(const char *name, const char *port_name,
+				   size_t *family_length);
+static int xcic_intl_metric_cmp(const void *a, const void *b);
+static struct xcic_poll_entry *xcic_intl_poll_entry_find(struct xcic_poller *poller,
+							 const struct xcic_poll_entry *key);
+static void xcic_intl_poll_entry_refresh(lua_State *L, struct xcic_port *xp,
+					 struct xcic_poll_entry *entry);
+static void xcic_intl_poll_entry_commit(struct xcic_poll_entry *entry,
+					const struct xcic_poll_entry *result);
+static struct xcic_poll_entry *xcic_intl_poller_next(struct xcic_poller *poller, double now,
+						      double *wait);
+static int xcic_intl_poller_f(va_list ap);
+static void xcic_intl_subscriptions_notify(struct xcic_port *xp,
+					   const struct xcic_poll_entry *entry);
+static void xcic_intl_subscription_notify(struct xcic_subscription *sub,
+					  const struct xcic_poll_entry *entry);
+static void xcic_intl_subscription_detach(lua_State *L, struct xcic_subscription *sub);
+static void xcic_intl_poller_delete(lua_State *L, struct xcic_poller *poller);
+static void xcic_intl_poller_stop(lua_State *L, struct xcic_port *xp);
+static void xcic_intl_subscriptions_detach(lua_State *L, struct xcic_port *xp);
+
+static int xcic_intl_object_number(const struct xcic_object *object, const char *value,
+				   double *number);
+static void xcic_intl_series_record(struct xcic_port *xp, struct xcic_poll_entry *entry);
+static void xcic_intl_series_flush(struct xcic_port *xp, struct xcic_poll_entry *entry);
+static void xcic_intl_series_write_block(struct xcic_port *xp, struct xcic_poll_entry *entry);
+static void xcic_intl_series_write_rollup(struct xcic_port *xp, struct xcic_poll_entry *entry,
+					  int tier, const struct xcic_series_rollup *rollup);
+static int xcic_intl_history_write(uint32_t space_id, const char *tuple, const char *tuple_end,
+				   const char *prefix, const char *prefix_end, uint32_t fieldno,
+				   uint64_t cutoff);
+static void xcic_intl_poll_entry_push(lua_State *L, const struct xcic_poll_entry *entry);
+
+static struct xcic_port *xcic_intl_port_find(const char *name);
+static void xcic_intl_port_unregister(lua_State *L, struct xcic_port *xp);
+
+/** Named ports in the order they were opened, linked by xcic_port::link. */
+static RLIST_HEAD(xcic_port_registry);
+
 #define xcic_lua_except_to(label, L, ...)                                                          \
 	({                                                                                         \
 		(void)lua_pushfstring(L, __VA_ARGS__);                                             \
@@ -116,36 +737,62 @@ static ssize_t xcic_intl_open_cb(va_list ap);
 int xcic_open_port(lua_State *L)
 {
 	if (lua_gettop(L) < 1)
-		return luaL_error(L, "Usage: xcic.open_port(pathname)");
+		return luaL_error(L, "Usage: xcic.open_port(pathname[, name])");
+
+	const char *name = luaL_optstring(L, 2, NULL);
+	if (name && xcic_intl_port_find(name))
+		return luaL_error(L, "port `%s` is already open", name);
 
 	struct xcic_port *xp = (struct xcic_port *)lua_newuserdata(L, sizeof(*xp));
 
 	memset(xp, 0, sizeof(*xp));
+	xp->fd = -1;
+	xp->self_ref = LUA_NOREF;
+	rlist_create(&xp->link);
+	xp->response_timeout = XCIC_RESPONSE_TIMEOUT;
+	xp->byte_timeout = XCIC_BYTE_TIMEOUT;
+	rlist_create(&xp->subscriptions);
 
 	const char *pathname = lua_tostring(L, 1);
 
-	xp->fd = coio_call(xcic_intl_open_cb, pathname, O_RDWR | O_NOCTTY | O_SYNC | O_NONBLOCK);
-	if (xp->fd == -1)
-		xcic_lua_except(L, "open: %s", strerror(errno));
-
-	struct termios tty = {.c_cflag = CS8 | CLOCAL | CREAD | PARENB};
+	if (xcic_intl_port_open(L, xp, pathname))
+		goto except;
 
-	(void)cfsetospeed(&tty, B38400);
-	(void)cfsetispeed(&tty, B38400);
+	xp->pathname = strdup(pathname);
+	if (!xp->pathname)
+		xcic_lua_except(L, "alloc failed");
 
-	if (tcsetattr(xp->fd, TCSANOW, &tty) == -1)
-		xcic_lua_except(L, "tcsetattr: %s", strerror(errno));
+	xp->ring = xcic_intl_ring_new(XCIC_RING_SIZE_DEFAULT);
+	if (!xp->ring)
+		xcic_lua_except(L, "alloc failed");
 
-	xp->latch = box_latch_new();
+	for (int i = 0; i < XCIC_PRIORITY_MAX; i++)
+		rlist_create(&xp->waiters[i]);
+	rlist_create(&xp->flights);
+	ibuf_create(&xp->ibuf, cord_slab_cache(), 512);
+	ibuf_create(&xp->rx, cord_slab_cache(), 512);
 
 	luaL_getmetatable(L, XCIC_PORT_LUA_UDATA_NAME);
 	lua_setmetatable(L, -2);
 
+	if (name) {
+		xp->name = strdup(name);
+		if (!xp->name)
+			return luaL_error(L, "alloc failed");
+
+		lua_pushvalue(L, -1);
+		xp->self_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+		rlist_add_tail(&xcic_port_registry, &xp->link);
+	}
+
 	return 1;
 
 except:
 	xcic_intl_port_close(xp);
 
+	free(xp->pathname);
+	xp->pathname = NULL;
+
 	return lua_error(L);
 }
 
@@ -157,7 +804,7 @@ int xcic_calc_checksum(lua_State *L)
 	size_t data_len;
 	const char *data = lua_tolstring(L, 1, &data_len);
 
-	lua_pushinteger(L, xcic_scom_calc_checksum(data, (uint16_t)data_len));
+	lua_pushinteger(L, xcic_codec_calc_checksum(data, (uint16_t)data_len));
 
 	return 1;
 }
@@ -169,8 +816,17 @@ int xcic_port_close(lua_State *L)
 
 	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
 
+	/* the poller and the subscriptions hold the port, none outlives its close */
+	xcic_intl_poller_stop(L, xp);
+	xcic_intl_subscriptions_detach(L, xp);
+
 	xcic_intl_port_close(xp);
 
+	free(xp->pathname);
+	xp->pathname = NULL;
+
+	xcic_intl_port_unregister(L, xp);
+
 	return 0;
 }
 
@@ -181,11 +837,390 @@ int xcic_port_usable(lua_State *L)
 
 	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
 
-	lua_pushboolean(L, xp->fd != -1);
+	lua_pushboolean(L, xp->pathname != NULL);
+
+	return 1;
+}
+
+int xcic_port_set_timeouts(lua_State *L)
+{
+	if (lua_gettop(L) < 2)
+		return luaL_error(L, "Usage: xp:set_timeouts(response_timeout[, byte_timeout])");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+
+	double response_timeout = luaL_checknumber(L, 2);
+	double byte_timeout = luaL_optnumber(L, 3, xp->byte_timeout);
+
+	if (response_timeout <= 0 || byte_timeout <= 0)
+		return luaL_error(L, "timeouts must be positive");
+
+	xp->response_timeout = response_timeout;
+	xp->byte_timeout = byte_timeout;
+
+	return 0;
+}
+
+int xcic_port_get_timeouts(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: xp:get_timeouts()");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+
+	lua_pushnumber(L, xp->response_timeout);
+	lua_pushnumber(L, xp->byte_timeout);
+
+	return 2;
+}
+
+/*
+ * Values of entries with a `series` id are kept as compressed blocks and
+ * 1 min / 1 h rollups in the given spaces; without arguments the history
+ * is flushed and turned off.
+ */
+int xcic_port_set_history(lua_State *L)
+{
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+
+	if (lua_gettop(L) < 3) {
+		if (xp->poller) {
+			for (size_t i = 0; i < xp->poller->entry_count; i++)
+				xcic_intl_series_flush(xp, &xp->poller->entries[i]);
+		}
+
+		free(xp->history);
+		xp->history = NULL;
+
+		return 0;
+	}
+
+	struct xcic_history history = {
+	    .block_space_id = luaL_checkinteger(L, 2),
+	    .rollup_space_id = luaL_checkinteger(L, 3),
+	    .retention = {6 * 3600, 86400, 90 * 86400},
+	};
+
+	if (lua_istable(L, 4)) {
+		static const char *const names[] = {"raw", "minute", "hour"};
+
+		for (int t = 0; t < XCIC_HISTORY_TIER_MAX; t++) {
+			lua_getfield(L, 4, names[t]);
+			if (!lua_isnil(L, -1))
+				history.retention[t] = lua_tonumber(L, -1);
+			lua_pop(L, 1);
+		}
+	}
+
+	if (!xp->history) {
+		xp->history = (struct xcic_history *)malloc(sizeof(*xp->history));
+		if (!xp->history)
+			return luaL_error(L, "alloc failed");
+	}
+
+	*xp->history = history;
+
+	return 0;
+}
+
+/*
+ * Appends every byte written to and read from the port to `pathname`,
+ * rotating it at `size_max` bytes and keeping `files` of them; decoded
+ * offline by xcireplay.
+ */
+int xcic_port_start_capture(lua_State *L)
+{
+	if (lua_gettop(L) < 2)
+		return luaL_error(L, "Usage: xp:start_capture(pathname[, size_max[, files]])");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+
+	const char *pathname = luaL_checkstring(L, 2);
+	lua_Integer size_max = luaL_optinteger(L, 3, 16 * 1024 * 1024);
+	lua_Integer files = luaL_optinteger(L, 4, 4);
+
+	if (size_max < XCIC_CAPTURE_FLUSH_SIZE || files < 1 || files > 99)
+		return luaL_error(L, "invalid size_max or files");
+
+	struct xcic_capture *capture = (struct xcic_capture *)calloc(1, sizeof(*capture));
+	if (!capture)
+		return luaL_error(L, "alloc failed");
+
+	capture->fd = -1;
+	capture->size_max = size_max;
+	capture->files = files;
+	ibuf_create(&capture->buf, cord_slab_cache(), XCIC_CAPTURE_FLUSH_SIZE);
+	ibuf_create(&capture->out, cord_slab_cache(), XCIC_CAPTURE_FLUSH_SIZE);
+
+	capture->pathname = strdup(pathname);
+	if (!capture->pathname)
+		xcic_lua_except(L, "alloc failed");
+
+	capture->cond = fiber_cond_new();
+	if (!capture->cond)
+		xcic_lua_except(L, "fiber_cond_new failed");
+
+	/* nothing to write yet, the file is opened */
+	if (coio_call(xcic_intl_capture_write_cb, capture))
+		xcic_lua_except(L, "%s: %s", pathname, strerror(capture->error));
+
+	capture->fiber = fiber_new("xcic_capture", xcic_intl_capture_f);
+	if (!capture->fiber)
+		xcic_lua_except(L, "fiber_new failed");
+
+	fiber_start(capture->fiber, capture);
+
+	xcic_intl_capture_delete(xp->capture);
+	xp->capture = capture;
+
+	return 0;
+
+except:
+	xcic_intl_capture_free(capture);
+
+	return lua_error(L);
+}
+
+int xcic_port_stop_capture(lua_State *L)
+{
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+
+	xcic_intl_capture_delete(xp->capture);
+	xp->capture = NULL;
+
+	return 0;
+}
+
+/*
+ * Counters of the port since it was opened. Latency histograms are keyed by
+ * device and object type, their buckets are cumulative like in Prometheus:
+ * {le = 0.005, count = n}, ..., {le = math.huge, count = total}.
+ */
+int xcic_port_stats(lua_State *L)
+{
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+	const struct xcic_port_stats *stats = &xp->stats;
+
+	lua_createtable(L, 0, 14);
+
+	lua_pushnumber(L, stats->requests);
+	lua_setfield(L, -2, "requests");
+	lua_pushnumber(L, stats->coalesced);
+	lua_setfield(L, -2, "coalesced");
+	lua_pushnumber(L, stats->cache_lookups);
+	lua_setfield(L, -2, "cache_lookups");
+	lua_pushnumber(L, stats->cache_hits);
+	lua_setfield(L, -2, "cache_hits");
+	lua_pushnumber(L, stats->bytes_out);
+	lua_setfield(L, -2, "bytes_out");
+	lua_pushnumber(L, stats->bytes_in);
+	lua_setfield(L, -2, "bytes_in");
+	lua_pushnumber(L, stats->checksum_errors);
+	lua_setfield(L, -2, "checksum_errors");
+	lua_pushnumber(L, stats->reopens);
+	lua_setfield(L, -2, "reopens");
+	lua_pushnumber(L, xp->rx_skipped);
+	lua_setfield(L, -2, "rx_skipped");
+	lua_pushnumber(L, xp->rx_dropped);
+	lua_setfield(L, -2, "rx_dropped");
+
+	lua_createtable(L, 0, XCIC_PRIORITY_MAX);
+	for (int i = 0; i < XCIC_PRIORITY_MAX; i++) {
+		const struct xcic_queue_stats *q = &stats->queue[i];
+
+		lua_createtable(L, 0, 6);
+		lua_pushnumber(L, q->depth);
+		lua_setfield(L, -2, "depth");
+		lua_pushnumber(L, q->depth_max);
+		lua_setfield(L, -2, "depth_max");
+		lua_pushnumber(L, q->acquired);
+		lua_setfield(L, -2, "acquired");
+		lua_pushnumber(L, q->waits);
+		lua_setfield(L, -2, "waits");
+		lua_pushnumber(L, q->wait);
+		lua_setfield(L, -2, "wait_time");
+		lua_pushnumber(L, q->wait_max);
+		lua_setfield(L, -2, "wait_max");
+		lua_setfield(L, -2, xcic_priority_names[i]);
+	}
+	lua_setfield(L, -2, "queue");
+
+	lua_createtable(L, 0, stats->error_count);
+	for (size_t i = 0; i < stats->error_count; i++) {
+		lua_pushnumber(L, stats->errors[i].count);
+		lua_setfield(L, -2, xcic_codec_strerror(stats->errors[i].code));
+	}
+	lua_setfield(L, -2, "errors");
+
+	lua_createtable(L, stats->latency_count, 0);
+	for (size_t i = 0; i < stats->latency_count; i++) {
+		const struct xcic_stats_latency *l = &stats->latencies[i];
+
+		lua_createtable(L, 0, 5);
+		lua_pushinteger(L, l->dst_addr);
+		lua_setfield(L, -2, "dst_addr");
+		lua_pushinteger(L, l->object_type);
+		lua_setfield(L, -2, "object_type");
+		lua_pushnumber(L, l->count);
+		lua_setfield(L, -2, "count");
+		lua_pushnumber(L, l->sum);
+		lua_setfield(L, -2, "sum");
+
+		uint64_t cumulative = 0;
+
+		lua_createtable(L, XCIC_STATS_BUCKET_COUNT, 0);
+		for (size_t b = 0; b < XCIC_STATS_BUCKET_COUNT; b++) {
+			cumulative += l->buckets[b];
+
+			lua_createtable(L, 0, 2);
+			lua_pushnumber(L, b < SCOM_NBR_ELEMENTS(xcic_stats_buckets)
+					      ? xcic_stats_buckets[b]
+					      : HUGE_VAL);
+			lua_setfield(L, -2, "le");
+			lua_pushnumber(L, cumulative);
+			lua_setfield(L, -2, "count");
+			lua_rawseti(L, -2, b + 1);
+		}
+		lua_setfield(L, -2, "buckets");
+
+		lua_rawseti(L, -2, i + 1);
+	}
+	lua_setfield(L, -2, "latency");
+
+	lua_pushnumber(L, stats->latency_untracked);
+	lua_setfield(L, -2, "latency_untracked");
+
+	return 1;
+}
+
+/* keeps the last `size` exchanges, 0 turns the ring off */
+int xcic_port_set_frame_ring(lua_State *L)
+{
+	if (lua_gettop(L) < 2)
+		return luaL_error(L, "Usage: xp:set_frame_ring(size)");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+
+	lua_Integer size = luaL_checkinteger(L, 2);
+	if (size < 0 || size > 65536)
+		return luaL_error(L, "invalid size");
+
+	struct xcic_ring *ring = NULL;
+
+	if (size > 0) {
+		ring = xcic_intl_ring_new(size);
+		if (!ring)
+			return luaL_error(L, "alloc failed");
+	}
+
+	/* an exchange in progress holds a slot of the ring */
+	xcic_intl_port_lock(xp, XCIC_PRIORITY_INTERACTIVE);
+	free(xp->ring);
+	xp->ring = ring;
+	xcic_intl_port_unlock(xp);
+
+	return 0;
+}
+
+/*
+ * Decodes the last `n` exchanges of the ring, oldest first:
+ * {ts, latency, error, request = {...}, response = {...}}; frames hold the
+ * header and property fields, the raw bytes and their length on the wire.
+ */
+int xcic_port_frames(lua_State *L)
+{
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+	struct xcic_ring *ring = xp->ring;
+
+	if (!ring) {
+		lua_newtable(L);
+		return 1;
+	}
+
+	uint64_t n = XCIC_MIN(ring->count, (uint64_t)ring->size);
+	lua_Integer limit = luaL_optinteger(L, 2, n);
+
+	if (limit >= 0 && (uint64_t)limit < n)
+		n = limit;
+
+	lua_createtable(L, n, 0);
+
+	for (uint64_t i = 0; i < n; i++) {
+		const struct xcic_ring_slot *slot =
+		    &ring->slots[(ring->count - n + i) % ring->size];
+
+		lua_createtable(L, 0, 5);
+
+		lua_pushnumber(L, slot->ts);
+		lua_setfield(L, -2, "ts");
+
+		if (slot->response_length) {
+			lua_pushnumber(L, slot->latency);
+			lua_setfield(L, -2, "latency");
+		}
+
+		if (slot->error != SCOM_ERROR_NO_ERROR) {
+			lua_pushstring(L, xcic_codec_strerror(slot->error));
+			lua_setfield(L, -2, "error");
+		}
+
+		xcic_intl_ring_frame_push(L, slot->request, slot->request_length);
+		lua_setfield(L, -2, "request");
+
+		if (slot->response_length) {
+			xcic_intl_ring_frame_push(L, slot->response, slot->response_length);
+			lua_setfield(L, -2, "response");
+		}
+
+		lua_rawseti(L, -2, i + 1);
+	}
 
 	return 1;
 }
 
+/*
+ * Serves reads from the values read within the last `user_info` or
+ * `parameter` seconds, `size` of them at most; reads may ask for another
+ * `max_age`. Without arguments the cache is dropped.
+ */
+int xcic_port_set_cache(lua_State *L)
+{
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+
+	if (lua_gettop(L) < 2 || lua_isnil(L, 2)) {
+		free(xp->cache);
+		xp->cache = NULL;
+		return 0;
+	}
+
+	luaL_checktype(L, 2, LUA_TTABLE);
+
+	lua_getfield(L, 2, "size");
+	lua_Integer size = luaL_optinteger(L, -1, 256);
+	lua_getfield(L, 2, "user_info");
+	double user_info_ttl = luaL_optnumber(L, -1, 1);
+	lua_getfield(L, 2, "parameter");
+	double parameter_ttl = luaL_optnumber(L, -1, 300);
+	lua_pop(L, 3);
+
+	if (size < 1 || size > 65536)
+		return luaL_error(L, "invalid size");
+
+	struct xcic_cache *cache =
+	    (struct xcic_cache *)calloc(1, sizeof(*cache) + size * sizeof(cache->entries[0]));
+	if (!cache)
+		return luaL_error(L, "alloc failed");
+
+	cache->size = size;
+	cache->user_info_ttl = user_info_ttl;
+	cache->parameter_ttl = parameter_ttl;
+
+	free(xp->cache);
+	xp->cache = cache;
+
+	return 0;
+}
+
 int xcic_port_to_string(lua_State *L)
 {
 	if (lua_gettop(L) < 1)
@@ -204,7 +1239,26 @@ int xcic_port_gc(lua_State *L)
 
 	xcic_intl_port_close(xp);
 
-	box_latch_delete(xp->latch);
+	free(xp->pathname);
+	xp->pathname = NULL;
+
+	free(xp->name);
+	xp->name = NULL;
+
+	ibuf_destroy(&xp->ibuf);
+	ibuf_destroy(&xp->rx);
+
+	free(xp->history);
+	xp->history = NULL;
+
+	xcic_intl_capture_delete(xp->capture);
+	xp->capture = NULL;
+
+	free(xp->ring);
+	xp->ring = NULL;
+
+	free(xp->cache);
+	xp->cache = NULL;
 
 	return 0;
 }
@@ -212,7 +1266,8 @@ int xcic_port_gc(lua_State *L)
 int xcic_port_read_user_info(lua_State *L)
 {
 	if (lua_gettop(L) < 3)
-		return luaL_error(L, "Usage: xp:read_user_info(dst_addr, object_id)");
+		return luaL_error(L, "Usage: xp:read_user_info(dst_addr, object_id"
+				     "[, timeout[, max_age]])");
 
 	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
 
@@ -229,12 +1284,12 @@ int xcic_port_read_user_info(lua_State *L)
 	property.object_id = lua_tointeger(L, 3);
 	property.property_id = 1;
 
-	struct ibuf ibuf __attribute__((cleanup(ibuf_destroy))) = {0};
-	ibuf_create(&ibuf, cord_slab_cache(), 32);
+	double timeout = luaL_optnumber(L, 4, 0);
+	double max_age = luaL_optnumber(L, 5, -1);
 
-	box_latch_lock(xp->latch);
-	int ret = xcic_scom_read_property(L, xp, &ibuf, &property, NULL, 0);
-	box_latch_unlock(xp->latch);
+	char value[XCIC_FRAME_DATA_SIZE_MAX];
+	int ret = xcic_intl_read_shared(L, xp, XCIC_PRIORITY_INTERACTIVE, timeout, max_age,
+					NULL, &property, value);
 
 	if (ret)
 		goto except;
@@ -251,7 +1306,7 @@ int xcic_port_read_parameter_property(lua_State *L)
 {
 	if (lua_gettop(L) < 3)
 		return luaL_error(L, "Usage: xp:read_parameter_property(dst_addr, "
-				     "object_id, property_id)");
+				     "object_id, property_id[, timeout[, max_age]])");
 
 	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
 
@@ -268,12 +1323,12 @@ int xcic_port_read_parameter_property(lua_State *L)
 	property.object_id = lua_tointeger(L, 3);
 	property.property_id = lua_tointeger(L, 4);
 
-	struct ibuf ibuf __attribute__((cleanup(ibuf_destroy))) = {0};
-	ibuf_create(&ibuf, cord_slab_cache(), 32);
+	double timeout = luaL_optnumber(L, 5, 0);
+	double max_age = luaL_optnumber(L, 6, -1);
 
-	box_latch_lock(xp->latch);
-	int ret = xcic_scom_read_property(L, xp, &ibuf, &property, NULL, 0);
-	box_latch_unlock(xp->latch);
+	char value[XCIC_FRAME_DATA_SIZE_MAX];
+	int ret = xcic_intl_read_shared(L, xp, XCIC_PRIORITY_INTERACTIVE, timeout, max_age,
+					NULL, &property, value);
 
 	if (ret)
 		goto except;
@@ -286,45 +1341,58 @@ except:
 	return lua_error(L);
 }
 
-int xcic_scom_read_property(lua_State *L, struct xcic_port *xp, struct ibuf *ibuf,
-			    scom_property_t *property, const char *data, size_t data_len)
+int xcic_port_read_user_info_typed(lua_State *L)
 {
-	uint32_t object_id = property->object_id;
+	if (lua_gettop(L) < 3)
+		return luaL_error(L, "Usage: xp:read_user_info_typed(dst_addr, "
+				     "object_id[, timeout[, max_age]])");
 
-	if (xcic_scom_encode_read_property(L, ibuf, property, data, data_len))
-		goto except;
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
 
-	if (xcic_scom_encode_request_frame(L, ibuf, property->frame))
-		goto except;
+	scom_frame_t frame;
+	scom_initialize_frame(&frame, NULL, 0);
 
-	if (xcic_scom_port_exchange(L, xp, ibuf, property->frame))
-		goto except;
+	frame.src_addr = 1;
+	frame.dst_addr = lua_tointeger(L, 2);
 
-	if (xcic_scom_decode_frame_data(L, property->frame)) {
-		xcic_scom_dump_faulty_frame(ibuf, property->frame);
-		goto except;
-	}
+	scom_property_t property;
+	scom_initialize_property(&property, &frame);
 
-	scom_initialize_property(property, property->frame);
+	property.object_type = SCOM_USER_INFO_OBJECT_TYPE;
+	property.object_id = lua_tointeger(L, 3);
+	property.property_id = 1;
 
-	if (xcic_scom_decode_read_property(L, property))
-		goto except;
+	const struct xcic_object *object =
+	    xcic_intl_object_find(property.object_type, property.object_id);
+	if (!object)
+		xcic_lua_except(L, "unknown user info %d", property.object_id);
 
-	if (object_id != property->object_id)
-		xcic_lua_except(L, "mismatch on object_id `%d` != `%d`", property->object_id,
-				object_id);
+	double timeout = luaL_optnumber(L, 4, 0);
+	double max_age = luaL_optnumber(L, 5, -1);
 
-	return 0;
+	char value[XCIC_FRAME_DATA_SIZE_MAX];
+	int ret = xcic_intl_read_shared(L, xp, XCIC_PRIORITY_INTERACTIVE, timeout, max_age,
+					NULL, &property, value);
+
+	if (ret)
+		goto except;
+
+	if (xcic_intl_object_check(L, object, property.value_length))
+		goto except;
+
+	xcic_intl_object_push(L, object, property.value_buffer);
+
+	return 1;
 
 except:
-	return -1; // caller must invoke `lua_error`
+	return lua_error(L);
 }
 
-int xcic_port_write_parameter_property(lua_State *L)
+int xcic_port_read_parameter_typed(lua_State *L)
 {
 	if (lua_gettop(L) < 4)
-		return luaL_error(L, "Usage: xp:write_parameter_property(dst_addr, "
-				     "object_id, property_id, data)");
+		return luaL_error(L, "Usage: xp:read_parameter_typed(dst_addr, "
+				     "object_id, property_id[, timeout[, max_age]])");
 
 	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
 
@@ -341,374 +1409,3775 @@ int xcic_port_write_parameter_property(lua_State *L)
 	property.object_id = lua_tointeger(L, 3);
 	property.property_id = lua_tointeger(L, 4);
 
-	size_t data_len;
-	const char *data = lua_tolstring(L, 5, &data_len);
+	const struct xcic_object *object =
+	    xcic_intl_object_find(property.object_type, property.object_id);
+	if (!object)
+		xcic_lua_except(L, "unknown parameter %d", property.object_id);
 
-	struct ibuf ibuf __attribute__((cleanup(ibuf_destroy))) = {0};
-	ibuf_create(&ibuf, cord_slab_cache(), 32);
+	double timeout = luaL_optnumber(L, 5, 0);
+	double max_age = luaL_optnumber(L, 6, -1);
 
-	box_latch_lock(xp->latch);
-	int ret = xcic_scom_write_property(L, xp, &ibuf, &property, data, data_len);
-	box_latch_unlock(xp->latch);
+	char value[XCIC_FRAME_DATA_SIZE_MAX];
+	int ret = xcic_intl_read_shared(L, xp, XCIC_PRIORITY_INTERACTIVE, timeout, max_age,
+					NULL, &property, value);
 
 	if (ret)
 		goto except;
 
-	return 0;
+	if (xcic_intl_object_check(L, object, property.value_length))
+		goto except;
+
+	xcic_intl_object_push(L, object, property.value_buffer);
+
+	return 1;
 
 except:
 	return lua_error(L);
 }
 
-int xcic_scom_write_property(lua_State *L, struct xcic_port *xp, struct ibuf *ibuf,
-			     scom_property_t *property, const char *data, size_t data_len)
+int xcic_port_read_many(lua_State *L)
 {
-	uint32_t object_id = property->object_id;
+	if (lua_gettop(L) < 2 || !lua_istable(L, 2))
+		return luaL_error(L, "Usage: xp:read_many({{dst_addr, object_type, "
+				     "object_id, property_id}, ...})");
 
-	if (xcic_scom_encode_write_property(L, ibuf, property, data, data_len))
-		goto except;
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
 
-	if (xcic_scom_encode_request_frame(L, ibuf, property->frame))
-		goto except;
+	int n = lua_objlen(L, 2);
 
-	if (xcic_scom_port_exchange(L, xp, ibuf, property->frame))
-		goto except;
+	lua_createtable(L, n, 0); // results
+	lua_createtable(L, 0, 0); // errors
 
-	if (xcic_scom_decode_frame_data(L, property->frame)) {
-		xcic_scom_dump_faulty_frame(ibuf, property->frame);
-		goto except;
-	}
+	xcic_intl_port_lock(xp, XCIC_PRIORITY_INTERACTIVE);
 
-	scom_initialize_property(property, property->frame);
+	for (int i = 1; i <= n; i++) {
+		/* a long batch lets writes in between its items */
+		xcic_intl_port_yield(xp);
 
-	if (xcic_scom_decode_write_property(L, property))
-		goto except;
+		lua_rawgeti(L, 2, i);
+		if (!lua_istable(L, -1)) {
+			lua_pop(L, 1);
+			lua_pushfstring(L, "invalid request #%d", i);
+			lua_rawseti(L, -2, i);
+			continue;
+		}
 
-	if (object_id != property->object_id)
-		xcic_lua_except(L, "mismatch on object_id `%d` != `%d`", property->object_id,
-				object_id);
+		lua_rawgeti(L, -1, 1);
+		lua_rawgeti(L, -2, 2);
+		lua_rawgeti(L, -3, 3);
+		lua_rawgeti(L, -4, 4);
 
-	return 0;
+		scom_frame_t frame;
+		scom_initialize_frame(&frame, NULL, 0);
 
-except:
-	return -1; // caller must invoke `lua_error`
+		frame.src_addr = 1;
+		frame.dst_addr = lua_tointeger(L, -4);
+
+		scom_property_t property;
+		scom_initialize_property(&property, &frame);
+
+		property.object_type = lua_tointeger(L, -3);
+		property.object_id = lua_tointeger(L, -2);
+		property.property_id = lua_isnil(L, -1) ? 1 : lua_tointeger(L, -1);
+
+		lua_pop(L, 5);
+
+		if (xcic_scom_read_property(L, xp, &xp->ibuf, &property, NULL, 0)) {
+			lua_rawseti(L, -2, i); // error saved
+			continue;
+		}
+
+		lua_pushlstring(L, property.value_buffer, property.value_length);
+		lua_rawseti(L, -3, i);
+	}
+
+	xcic_intl_port_unlock(xp);
+
+	return 2;
 }
 
-int xcic_port_read_message(lua_State *L)
+int xcic_prepare_read(lua_State *L)
 {
 	if (lua_gettop(L) < 3)
-		return luaL_error(L, "Usage: xp:read_message(dst_addr, object_id)");
+		return luaL_error(L, "Usage: xcic.prepare_read(dst_addr, object_type, "
+				     "object_id[, property_id])");
+
+	struct xcic_request *request = (struct xcic_request *)lua_newuserdata(L, sizeof(*request));
+
+	memset(request, 0, sizeof(*request));
+
+	request->dst_addr = lua_tointeger(L, 1);
+	request->object_type = lua_tointeger(L, 2);
+	request->object_id = lua_tointeger(L, 3);
+	request->property_id = lua_isnoneornil(L, 4) ? 1 : lua_tointeger(L, 4);
+
+	if (xcic_codec_prepare_read_property(request))
+		return luaL_error(L, "read property frame encoding failed");
+
+	luaL_getmetatable(L, XCIC_REQUEST_LUA_UDATA_NAME);
+	lua_setmetatable(L, -2);
+
+	return 1;
+}
+
+int xcic_port_read_prepared(lua_State *L)
+{
+	if (lua_gettop(L) < 2)
+		return luaL_error(L, "Usage: xp:read_prepared(request[, timeout[, max_age]])");
 
 	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+	struct xcic_request *request =
+	    (struct xcic_request *)luaL_checkudata(L, 2, XCIC_REQUEST_LUA_UDATA_NAME);
+
+	const struct xcic_object *object =
+	    xcic_intl_object_find(request->object_type, request->object_id);
 
 	scom_frame_t frame;
 	scom_initialize_frame(&frame, NULL, 0);
 
-	frame.src_addr = 1;
-	frame.dst_addr = lua_tointeger(L, 2);
-
 	scom_property_t property;
 	scom_initialize_property(&property, &frame);
 
-	property.object_type = 3; // message
-	property.object_id = lua_tointeger(L, 3);
-	property.property_id = 0;
-
-	struct ibuf ibuf __attribute__((cleanup(ibuf_destroy))) = {0};
-	ibuf_create(&ibuf, cord_slab_cache(), 32);
+	double timeout = luaL_optnumber(L, 3, 0);
+	double max_age = luaL_optnumber(L, 4, -1);
 
-	box_latch_lock(xp->latch);
-	int ret = xcic_scom_read_property(L, xp, &ibuf, &property, NULL, 0);
-	box_latch_unlock(xp->latch);
+	char value[XCIC_FRAME_DATA_SIZE_MAX];
+	int ret = xcic_intl_read_shared(L, xp, XCIC_PRIORITY_INTERACTIVE, timeout, max_age,
+					request, &property, value);
 
 	if (ret)
 		goto except;
 
-	if (property.value_length != 4 + 2 + 4 + 4 + 4)
-		xcic_lua_except(L, "invalid message data length %d", property.value_length);
+	if (!object) {
+		lua_pushlstring(L, property.value_buffer, property.value_length);
+		return 1;
+	}
 
-	lua_pushinteger(L, scom_read_le32(&property.value_buffer[0]));
-	lua_pushinteger(L, scom_read_le16(&property.value_buffer[4]));
-	lua_pushinteger(L, scom_read_le32(&property.value_buffer[6]));
-	lua_pushinteger(L, scom_read_le32(&property.value_buffer[10]));
-	lua_pushinteger(L, scom_read_le32(&property.value_buffer[14]));
+	if (xcic_intl_object_check(L, object, property.value_length))
+		goto except;
 
-	return 5;
+	xcic_intl_object_push(L, object, property.value_buffer);
+
+	return 1;
 
 except:
 	return lua_error(L);
 }
 
-int xcic_port_read_datalog_dir(lua_State *L)
+int xcic_scom_read_property(lua_State *L, struct xcic_port *xp, struct ibuf *ibuf,
+			    scom_property_t *property, const char *data, size_t data_len)
 {
-	if (lua_gettop(L) < 2)
-		return luaL_error(L, "Usage: xp:read_datalog_dir(dst_addr)");
-
-	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
-	uint32_t dst_addr = lua_tointeger(L, 2);
-	uint32_t object_id = 1; // directory list
-
-	struct ibuf rbuf __attribute__((cleanup(ibuf_destroy))) = {0};
-	ibuf_create(&rbuf, cord_slab_cache(), 4096);
+	uint32_t object_id = property->object_id;
 
-	box_latch_lock(xp->latch);
-	int ret = xcic_scom_xfer_datalog(L, xp, dst_addr, object_id, NULL, 0, &rbuf);
-	box_latch_unlock(xp->latch);
+	ibuf_reset(ibuf);
 
-	if (ret)
+	if (xcic_scom_encode_read_property(L, ibuf, property, data, data_len))
 		goto except;
 
-	lua_pushlstring(L, rbuf.rpos, ibuf_used(&rbuf));
+	if (xcic_scom_encode_request_frame(L, ibuf, property->frame))
+		goto except;
 
-	return 1;
+	return xcic_scom_read_response(L, xp, ibuf, property, object_id);
 
 except:
-	return lua_error(L);
+	return -1; // caller must invoke `lua_error`
 }
 
-int xcic_port_read_datalog_file(lua_State *L)
+int xcic_scom_read_prepared(lua_State *L, struct xcic_port *xp, struct ibuf *ibuf,
+			    const struct xcic_request *request, scom_property_t *property)
 {
-	if (lua_gettop(L) < 3)
-		return luaL_error(L, "Usage: xp:read_datalog_file(dst_addr, filename)");
+	scom_frame_t *frame = property->frame;
 
-	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
-	uint32_t dst_addr = lua_tointeger(L, 2);
-	uint32_t object_id = 2; // file access
+	/* the exchange only reads the request bytes before pointing the frame
+	 * at `ibuf` for the response */
+	scom_initialize_frame(frame, (char *)request->frame, request->length);
 
-	size_t data_len;
-	const char *data = lua_tolstring(L, 3, &data_len);
+	frame->src_addr = 1;
+	frame->dst_addr = request->dst_addr;
+	frame->data_length = request->length - SCOM_FRAME_HEADER_SIZE - 2;
 
-	struct ibuf rbuf __attribute__((cleanup(ibuf_destroy))) = {0};
-	ibuf_create(&rbuf, cord_slab_cache(), 4096);
+	return xcic_scom_read_response(L, xp, ibuf, property, request->object_id);
+}
 
-	box_latch_lock(xp->latch);
-	int ret = xcic_scom_xfer_datalog(L, xp, dst_addr, object_id, data, data_len, &rbuf);
-	box_latch_unlock(xp->latch);
+int xcic_scom_read_response(lua_State *L, struct xcic_port *xp, struct ibuf *ibuf,
+			    scom_property_t *property, uint32_t object_id)
+{
+	if (xcic_scom_port_exchange(L, xp, ibuf, property->frame))
+		goto except;
 
-	if (ret)
+	if (xcic_scom_decode_frame_data(L, property->frame)) {
+		xp->stats.checksum_errors++;
+		xcic_scom_dump_faulty_frame(ibuf, property->frame);
 		goto except;
+	}
 
-	lua_pushlstring(L, rbuf.rpos, ibuf_used(&rbuf));
+	scom_initialize_property(property, property->frame);
 
-	return 1;
+	if (xcic_scom_decode_read_property(L, property))
+		goto except;
+
+	if (object_id != property->object_id) {
+		property->frame->last_error = SCOM_ERROR_STACK_PROPERTY_HEADER_DOESNT_MATCH;
+		xcic_lua_except(L, "mismatch on object_id `%d` != `%d`", property->object_id,
+				object_id);
+	}
+
+	return 0;
 
 except:
-	return lua_error(L);
-}
+	xcic_intl_stats_error(xp, property->frame->last_error);
 
-enum xcic_xfer_state {
-	XCIC_XFER_START = 0x21,	   /*SD_Start*/
-	XCIC_XFER_CONTINUE = 0x23, /*SD_Ack_Continue*/
-	XCIC_XFER_RETRY = 0x24,	   /*SD_Nack_Retry*/
-	XCIC_XFER_ABORT = 0x25,	   /*SD_Abort*/
-};
+	return -1; // caller must invoke `lua_error`
+}
 
-int xcic_scom_xfer_datalog(lua_State *L, struct xcic_port *xp, uint32_t dst_addr,
-			   uint32_t object_id, const char *data, size_t data_len, struct ibuf *rbuf)
+/* the units of a class present on the bus, all the range until set or discovered */
+int xcic_port_set_fleet(lua_State *L)
 {
-	struct ibuf ibuf __attribute__((cleanup(ibuf_destroy))) = {0};
-	ibuf_create(&ibuf, cord_slab_cache(), 256);
+	if (lua_gettop(L) < 3 || !lua_istable(L, 3))
+		return luaL_error(L, "Usage: xp:set_fleet(class, {dst_addr, ...})");
 
-	scom_frame_t frame;
-	scom_property_t property;
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
 
-	void *ptr;
-	enum xcic_xfer_state xfst = XCIC_XFER_START;
+	int c = xcic_intl_device_class_find(luaL_checkstring(L, 2));
+	if (c == -1)
+		return luaL_error(L, "unknown device class `%s`", lua_tostring(L, 2));
 
-	for (;;) {
-		ibuf_reset(&ibuf);
+	const struct xcic_device_class *dc = &xcic_device_classes[c];
+	uint32_t members = 0;
 
-		scom_initialize_frame(&frame, NULL, 0);
-		frame.src_addr = 1;
-		frame.dst_addr = dst_addr;
+	for (int i = 1, n = lua_objlen(L, 3); i <= n; i++) {
+		lua_rawgeti(L, 3, i);
+		lua_Integer addr = lua_tointeger(L, -1);
+		lua_pop(L, 1);
 
-		scom_initialize_property(&property, &frame);
-		property.object_type = 0x101; // datalog transfer
-		property.object_id = object_id;
-		property.property_id = (uint32_t)xfst;
+		if (addr < dc->first_addr || addr > dc->last_addr)
+			return luaL_error(L, "address %d is not of class `%s`", (int)addr,
+					  dc->name);
 
-		say_info(" -> xfst 0x%x prop 0x%x data `%.*s`", xfst, property.property_id,
-			 data_len, data);
+		members |= 1u << (addr - dc->first_addr);
+	}
 
-		if (xcic_scom_read_property(L, xp, &ibuf, &property, data, data_len))
-			switch (xfst) {
-			case XCIC_XFER_ABORT:
-				lua_pop(L, -1); // drop last error
-				goto except;
-			case XCIC_XFER_CONTINUE:
-				lua_pop(L, -1); // drop last error
-				xfst = XCIC_XFER_RETRY;
-				continue;
-			default:
-				goto abort; // error saved
-			}
+	xp->fleet[c] = members;
+	xp->fleet_known |= 1u << c;
 
-		if (xfst == XCIC_XFER_ABORT)
-			goto except;
+	return 0;
+}
+
+int xcic_port_get_fleet(lua_State *L)
+{
+	if (lua_gettop(L) < 2)
+		return luaL_error(L, "Usage: xp:get_fleet(class)");
 
-		say_info("<-  xfst 0x%x prop 0x%x vl %d rl %d", xfst, property.property_id,
-			 property.value_length, ibuf_used(rbuf));
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
 
-		if (property.value_length) {
-			ptr = ibuf_alloc(rbuf, property.value_length);
-			if (!ptr)
-				xcic_lua_except_to(abort, L, "alloc failed");
+	int c = xcic_intl_device_class_find(luaL_checkstring(L, 2));
+	if (c == -1)
+		return luaL_error(L, "unknown device class `%s`", lua_tostring(L, 2));
 
-			memcpy(ptr, property.value_buffer, property.value_length);
-		}
+	const struct xcic_device_class *dc = &xcic_device_classes[c];
+	int n = 0;
 
-		xfst = XCIC_XFER_CONTINUE;
-		if (property.property_id == 0x22 /*SD_Datablock*/)
-			continue;
-		else if (property.property_id == 0x26 /*SD_Finish*/)
-			break;
+	lua_newtable(L);
 
-	abort:
-		xfst = XCIC_XFER_ABORT;
+	for (uint32_t addr = dc->first_addr; addr <= dc->last_addr; addr++) {
+		if (xp->fleet[c] & (1u << (addr - dc->first_addr))) {
+			lua_pushinteger(L, addr);
+			lua_rawseti(L, -2, ++n);
+		}
 	}
 
-	return 0;
-
-except:
-	return -1; // caller must invoke `lua_error'
+	return 1;
 }
 
-int xcic_scom_port_exchange(lua_State *L, struct xcic_port *xp, struct ibuf *ibuf,
-			    scom_frame_t *frame)
+/*
+ * Reads an object from every unit of a class in one turn on the port and
+ * aggregates the values: {units = {{dst_addr, value | error}, ...}, count,
+ * sum, min, max}. Values are decoded by the catalog, unknown objects are
+ * taken for floats.
+ */
+int xcic_port_read_fleet(lua_State *L)
 {
-	ssize_t nb;
+	if (lua_gettop(L) < 3)
+		return luaL_error(L, "Usage: xp:read_fleet(class, object_id[, object_type[, "
+				     "property_id[, timeout]]])");
 
-	uint32_t dst_addr = frame->dst_addr;
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
 
-	nb = xcic_intl_port_write(xp, frame->buffer, scom_frame_length(frame));
+	int c = xcic_intl_device_class_find(luaL_checkstring(L, 2));
+	if (c == -1)
+		return luaL_error(L, "unknown device class `%s`", lua_tostring(L, 2));
 
-	if (nb != (ssize_t)scom_frame_length(frame))
-		xcic_lua_except(L, "error when writing to the com port");
+	const struct xcic_device_class *dc = &xcic_device_classes[c];
+	uint32_t object_id = luaL_checkinteger(L, 3);
+	scom_object_type_t object_type = luaL_optinteger(L, 4, SCOM_USER_INFO_OBJECT_TYPE);
+	uint16_t property_id = luaL_optinteger(L, 5, 1);
+	double timeout = luaL_optnumber(L, 6, 0);
 
-	ibuf_reset(ibuf);
+	const struct xcic_object *object = xcic_intl_object_find(object_type, object_id);
+	uint32_t members = xp->fleet_known & (1u << c)
+			       ? xp->fleet[c]
+			       : (1u << (dc->last_addr - dc->first_addr + 1)) - 1;
 
-	if (!ibuf_alloc(ibuf, SCOM_FRAME_HEADER_SIZE))
-		xcic_lua_except(L, "alloc failed");
+	double sum = 0, min = HUGE_VAL, max = -HUGE_VAL;
+	int count = 0, n = 0;
 
-	scom_initialize_frame(frame, ibuf->rpos, ibuf_used(ibuf));
+	lua_createtable(L, 0, 5);
+	lua_newtable(L); // units
 
-	nb = xcic_intl_port_read(xp, frame->buffer, SCOM_FRAME_HEADER_SIZE);
+	xcic_intl_port_lock(xp, XCIC_PRIORITY_INTERACTIVE);
 
-	if (nb != SCOM_FRAME_HEADER_SIZE)
-		xcic_lua_except(L, "error when reading the header from the com port");
+	for (uint32_t addr = dc->first_addr; addr <= dc->last_addr; addr++) {
+		if (!(members & (1u << (addr - dc->first_addr))))
+			continue;
 
-	/* scom_frame_length() is incorrect as `frame->data_length` is still
-	 * empty */
-	ssize_t rlen = scom_read_le16(&frame->buffer[10]) + 2;
+		xcic_intl_port_yield(xp);
 
-	if (!ibuf_alloc(ibuf, rlen))
-		xcic_lua_except(L, "alloc failed");
+		scom_frame_t frame;
+		scom_initialize_frame(&frame, NULL, 0);
+
+		frame.src_addr = 1;
+		frame.dst_addr = addr;
 
-	frame->buffer = ibuf->rpos;
-	frame->buffer_size = ibuf_used(ibuf);
+		scom_property_t property;
+		scom_initialize_property(&property, &frame);
 
-	if (xcic_scom_decode_frame_header(L, frame))
-		goto except;
+		property.object_type = object_type;
+		property.object_id = object_id;
+		property.property_id = property_id;
 
-	nb = xcic_intl_port_read(xp, &frame->buffer[SCOM_FRAME_HEADER_SIZE], rlen);
+		lua_createtable(L, 0, 2);
+		lua_pushinteger(L, addr);
+		lua_setfield(L, -2, "dst_addr");
 
-	if (nb != rlen)
-		xcic_lua_except(L, "error when reading the data from the com port");
+		xp->timeout = timeout;
 
-	if (dst_addr != frame->src_addr)
-		xcic_lua_except(L, "mismatch on address `%d` != `%d`", dst_addr, frame->dst_addr);
+		if (xcic_scom_read_property(L, xp, &xp->ibuf, &property, NULL, 0) ||
+		    (object && xcic_intl_object_check(L, object, property.value_length))) {
+			lua_setfield(L, -2, "error"); // error saved
+			lua_rawseti(L, -2, ++n);
+			continue;
+		}
 
-	return 0;
+		double value = 0;
 
-except:
-	xcic_intl_port_close(xp);
+		if (object ? xcic_intl_object_number(object, property.value_buffer, &value)
+			   : property.value_length != 4) {
+			lua_pushliteral(L, "not a number");
+			lua_setfield(L, -2, "error");
+			lua_rawseti(L, -2, ++n);
+			continue;
+		}
 
-	return -1; // caller must invoke `lua_error`
-}
+		if (!object)
+			value = scom_read_le_float(property.value_buffer);
 
-uint16_t xcic_scom_calc_checksum(const char *data, uint_fast16_t length)
-{
-	uint_fast8_t A = 0xFF, B = 0;
+		lua_pushnumber(L, value);
+		lua_setfield(L, -2, "value");
+		lua_rawseti(L, -2, ++n);
 
-	while (length--) {
-		A = (A + *data++) & 0xFF;
-		B = (B + A) & 0xFF;
+		sum += value;
+		min = value < min ? value : min;
+		max = value > max ? value : max;
+		count++;
 	}
 
-	return (B & 0xFF) << 8 | (A & 0xFF);
-}
+	xcic_intl_port_unlock(xp);
 
-void xcic_scom_dump_faulty_frame(struct ibuf *ibuf, scom_frame_t *frame)
-{
-	size_t len = scom_frame_length(frame);
-	char *esc = (char *)static_reserve(len * 4 + 1);
+	lua_setfield(L, -2, "units");
 
-	if (esc) {
-		char *ptr = esc;
-		for (size_t i = 0; i < scom_frame_length(frame); i++)
-			ptr += sprintf(ptr, "\\%d", (uint8_t)frame->buffer[i]);
+	lua_pushinteger(L, count);
+	lua_setfield(L, -2, "count");
+	lua_pushnumber(L, sum);
+	lua_setfield(L, -2, "sum");
 
-		*ptr = '\0';
+	if (count) {
+		lua_pushnumber(L, min);
+		lua_setfield(L, -2, "min");
+		lua_pushnumber(L, max);
+		lua_setfield(L, -2, "max");
 	}
 
-	uint16_t cs =
-	    xcic_scom_calc_checksum(&frame->buffer[SCOM_FRAME_HEADER_SIZE], frame->data_length);
-
-	say_info("xcic: faulty frame len %d iu %d cs %d esc %s", len, ibuf_used(ibuf), cs,
-		 esc ?: "-");
+	return 1;
 }
 
-int xcic_scom_encode_read_property(lua_State *L, struct ibuf *ibuf, scom_property_t *property,
-				   const char *data, size_t data_len)
+/*
+ * Finds the units of each probed class and their firmware, with a short
+ * response timeout: {xt = {units = {{dst_addr, version}, ...}, objects =
+ * {[object_id] = true, ...}}, ...}. Units take consecutive addresses, so a
+ * class is done at the first address answered with device_not_found or not
+ * at all, twice. A unit is present when it answers, be it with an object
+ * error; port and stack errors end the discovery with an error and leave
+ * the fleets as they were. The catalog objects of a class are probed on its
+ * first unit. The members found are set for read_fleet.
+ */
+int xcic_port_discover(lua_State *L)
 {
-	size_t offset = SCOM_FRAME_HEADER_SIZE + 2 + 8;
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+	double timeout = luaL_optnumber(L, 2, 0.25);
 
-	if (!ibuf_alloc(ibuf, offset + data_len))
-		xcic_lua_except(L, "alloc failed");
+	uint32_t found[XCIC_DEVICE_CLASS_COUNT] = {0};
+	uint32_t known = 0;
 
-	memcpy(ibuf->rpos + offset, data, data_len);
+	const struct xcic_device_class *dc = NULL;
+	uint32_t addr = 0;
+	scom_error_t error;
 
-	property->frame->buffer = ibuf->rpos;
-	property->frame->buffer_size = ibuf_used(ibuf);
-	property->value_length = data_len;
+	lua_newtable(L);
 
-	scom_encode_read_property(property);
+	for (int c = 0; c < XCIC_DEVICE_CLASS_COUNT; c++) {
+		dc = &xcic_device_classes[c];
+		uint32_t members = 0;
+		int n = 0;
 
-	/* scom_encode_read_property() resets `property->value_length` */
-	property->value_length = data_len;
-	property->frame->data_length += property->value_length;
+		if (!dc->version_msb)
+			continue;
 
-	if (property->frame->last_error != SCOM_ERROR_NO_ERROR)
-		xcic_lua_except(L, "read property frame encoding failed with error %d (%s)",
-				property->frame->last_error,
-				xcic_scom_strerror(property->frame->last_error));
+		lua_createtable(L, 0, 2);
+		lua_newtable(L); // units
 
-	return 0;
+		for (addr = dc->first_addr; addr <= dc->last_addr; addr++) {
+			char msb[4], lsb[4];
 
-except:
-	return -1; // caller must invoke `lua_error`
-}
+			error = xcic_intl_probe(L, xp, addr, dc->version_msb, timeout, msb);
+			if (error == SCOM_ERROR_DEVICE_NOT_FOUND ||
+			    error == SCOM_ERROR_RESPONSE_TIMEOUT)
+				break;
 
-int xcic_scom_encode_write_property(lua_State *L, struct ibuf *ibuf, scom_property_t *property,
-				    const char *data, size_t data_len)
-{
-	size_t offset = SCOM_FRAME_HEADER_SIZE + 2 + 8;
+			if (!xcic_intl_probe_answered(error))
+				goto except;
 
-	if (!ibuf_alloc(ibuf, offset + data_len))
+			members |= 1u << (addr - dc->first_addr);
+
+			lua_createtable(L, 0, 2);
+			lua_pushinteger(L, addr);
+			lua_setfield(L, -2, "dst_addr");
+
+			if (error == SCOM_ERROR_NO_ERROR) {
+				error = xcic_intl_probe(L, xp, addr, dc->version_lsb, timeout, lsb);
+				if (!xcic_intl_probe_answered(error) &&
+				    error != SCOM_ERROR_RESPONSE_TIMEOUT)
+					goto except;
+			}
+
+			if (error == SCOM_ERROR_NO_ERROR) {
+				uint16_t v_msb = (uint16_t)scom_read_le_float(msb);
+				uint16_t v_lsb = (uint16_t)scom_read_le_float(lsb);
+
+				lua_pushfstring(L, "%d.%d.%d", v_msb >> 8, v_lsb >> 8,
+						v_lsb & 0xFF);
+				lua_setfield(L, -2, "version");
+			}
+
+			lua_rawseti(L, -2, ++n);
+		}
+
+		lua_setfield(L, -2, "units");
+
+		if (members) {
+			addr = dc->first_addr;
+			error = xcic_intl_probe_objects(L, xp, dc, addr, timeout);
+			if (error != SCOM_ERROR_NO_ERROR)
+				goto except;
+
+			lua_setfield(L, -2, "objects");
+		}
+
+		lua_setfield(L, -2, dc->name);
+
+		found[c] = members;
+		known |= 1u << c;
+
+		say_info("xcic: discovered %d %s unit(s)", n, dc->name);
+	}
+
+	for (int c = 0; c < XCIC_DEVICE_CLASS_COUNT; c++) {
+		if (known & (1u << c))
+			xp->fleet[c] = found[c];
+	}
+
+	xp->fleet_known |= known;
+
+	return 1;
+
+except:
+	lua_pushfstring(L, "discovery of %s at %d: %s", dc->name, (int)addr,
+			xcic_codec_strerror(error));
+
+	return lua_error(L);
+}
+
+int xcic_port_write_parameter_property(lua_State *L)
+{
+	if (lua_gettop(L) < 4)
+		return luaL_error(L, "Usage: xp:write_parameter_property(dst_addr, "
+				     "object_id, property_id, data[, timeout])");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+
+	scom_frame_t frame;
+	scom_initialize_frame(&frame, NULL, 0);
+
+	frame.src_addr = 1;
+	frame.dst_addr = lua_tointeger(L, 2);
+
+	scom_property_t property;
+	scom_initialize_property(&property, &frame);
+
+	property.object_type = SCOM_PARAMETER_OBJECT_TYPE;
+	property.object_id = lua_tointeger(L, 3);
+	property.property_id = lua_tointeger(L, 4);
+
+	size_t data_len;
+	const char *data = lua_tolstring(L, 5, &data_len);
+
+	double timeout = luaL_optnumber(L, 6, 0);
+
+	xcic_intl_port_lock(xp, XCIC_PRIORITY_CONTROL);
+	xp->timeout = timeout;
+	int ret = xcic_scom_write_property(L, xp, &xp->ibuf, &property, data, data_len);
+	xcic_intl_port_unlock(xp);
+
+	/* even a failed write may have reached the device */
+	if (xp->cache)
+		xcic_intl_cache_invalidate(xp->cache, lua_tointeger(L, 2),
+					   SCOM_PARAMETER_OBJECT_TYPE, lua_tointeger(L, 3));
+
+	if (ret)
+		goto except;
+
+	return 0;
+
+except:
+	return lua_error(L);
+}
+
+int xcic_scom_write_property(lua_State *L, struct xcic_port *xp, struct ibuf *ibuf,
+			     scom_property_t *property, const char *data, size_t data_len)
+{
+	uint32_t object_id = property->object_id;
+
+	ibuf_reset(ibuf);
+
+	if (xcic_scom_encode_write_property(L, ibuf, property, data, data_len))
+		goto except;
+
+	if (xcic_scom_encode_request_frame(L, ibuf, property->frame))
+		goto except;
+
+	if (xcic_scom_port_exchange(L, xp, ibuf, property->frame))
+		goto except;
+
+	if (xcic_scom_decode_frame_data(L, property->frame)) {
+		xp->stats.checksum_errors++;
+		xcic_scom_dump_faulty_frame(ibuf, property->frame);
+		goto except;
+	}
+
+	scom_initialize_property(property, property->frame);
+
+	if (xcic_scom_decode_write_property(L, property))
+		goto except;
+
+	if (object_id != property->object_id) {
+		property->frame->last_error = SCOM_ERROR_STACK_PROPERTY_HEADER_DOESNT_MATCH;
+		xcic_lua_except(L, "mismatch on object_id `%d` != `%d`", property->object_id,
+				object_id);
+	}
+
+	return 0;
+
+except:
+	xcic_intl_stats_error(xp, property->frame->last_error);
+
+	return -1; // caller must invoke `lua_error`
+}
+
+int xcic_port_read_message(lua_State *L)
+{
+	if (lua_gettop(L) < 3)
+		return luaL_error(L, "Usage: xp:read_message(dst_addr, object_id[, timeout])");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+	uint32_t dst_addr = lua_tointeger(L, 2);
+	uint32_t index = lua_tointeger(L, 3);
+
+	double timeout = luaL_optnumber(L, 4, 0);
+
+	struct xcic_message message;
+
+	xcic_intl_port_lock(xp, XCIC_PRIORITY_INTERACTIVE);
+	xp->timeout = timeout;
+	int ret = xcic_intl_message_read(L, xp, dst_addr, index, &message);
+	xcic_intl_port_unlock(xp);
+
+	if (ret)
+		goto except;
+
+	lua_pushinteger(L, message.count);
+	lua_pushinteger(L, message.type);
+	lua_pushinteger(L, message.src_addr);
+	lua_pushinteger(L, message.ts);
+	lua_pushinteger(L, message.value);
+
+	return 5;
+
+except:
+	return lua_error(L);
+}
+
+/*
+ * Reads the messages logged since the previous sync and stores them oldest
+ * first in one transaction. Index 0 is the newest message and reading it
+ * points the device at it, higher indices count back from there. An
+ * unchanged log costs that single exchange; otherwise the log is walked back
+ * to the newest message stored. A log shorter than at the previous sync was
+ * cleared and is read in full, the primary key keeps that idempotent.
+ */
+int xcic_port_sync_messages(lua_State *L)
+{
+	if (lua_gettop(L) < 3)
+		return luaL_error(L, "Usage: xp:sync_messages(dst_addr, space_id)");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+	uint32_t dst_addr = lua_tointeger(L, 2);
+	uint32_t space_id = luaL_checkinteger(L, 3);
+
+	struct xcic_message_cursor *cursor = xcic_intl_message_cursor(xp, dst_addr);
+	if (!cursor)
+		return luaL_error(L, "too many message sources");
+
+	struct xcic_message *messages = NULL;
+	size_t count = 0;
+	char errmsg[XCIC_ERRMSG_SIZE_MAX];
+
+	xcic_intl_port_lock(xp, XCIC_PRIORITY_INTERACTIVE);
+
+	struct xcic_message probe;
+
+	if (xcic_intl_message_read(L, xp, dst_addr, 0, &probe))
+		goto unlock;
+
+	if (probe.count < cursor->count)
+		cursor->count = 0;
+
+	if (probe.count) {
+		messages = (struct xcic_message *)calloc(probe.count, sizeof(*messages));
+		if (!messages) {
+			lua_pushstring(L, "alloc failed");
+			goto unlock;
+		}
+	}
+
+	for (uint32_t i = 0; i < probe.count; i++) {
+		struct xcic_message *m = &messages[count];
+		const struct xcic_message *last = &cursor->last;
+
+		if (!i)
+			*m = probe;
+		else if (xcic_intl_message_read(L, xp, dst_addr, i, m))
+			goto unlock;
+
+		/* reached what the previous sync stored, or went past it */
+		if (cursor->count &&
+		    ((m->ts == last->ts && m->type == last->type && m->src_addr == last->src_addr &&
+		      m->value == last->value) ||
+		     m->ts < last->ts))
+			break;
+
+		count++;
+	}
+
+	xcic_intl_port_unlock(xp);
+
+	/* read newest first, stored and returned oldest first */
+	for (size_t i = 0; i < count / 2; i++) {
+		struct xcic_message m = messages[i];
+		messages[i] = messages[count - 1 - i];
+		messages[count - 1 - i] = m;
+	}
+
+	if (xcic_intl_messages_store(space_id, messages, count, errmsg, sizeof(errmsg)))
+		xcic_lua_except(L, "xci_message: %s", errmsg);
+
+	cursor->count = probe.count;
+	if (probe.count)
+		cursor->last = probe;
+	else
+		memset(&cursor->last, 0, sizeof(cursor->last));
+
+	lua_createtable(L, count, 0);
+
+	for (size_t i = 0; i < count; i++) {
+		lua_createtable(L, 0, 5);
+
+		lua_pushinteger(L, messages[i].ts);
+		lua_setfield(L, -2, "ts");
+
+		lua_pushinteger(L, messages[i].src_addr);
+		lua_setfield(L, -2, "src_addr");
+
+		lua_pushinteger(L, messages[i].type);
+		lua_setfield(L, -2, "type");
+
+		lua_pushinteger(L, messages[i].value);
+		lua_setfield(L, -2, "value");
+
+		const char *text = xcic_intl_message_text(messages[i].type);
+		if (text) {
+			lua_pushstring(L, text);
+			lua_setfield(L, -2, "message");
+		}
+
+		lua_rawseti(L, -2, i + 1);
+	}
+
+	free(messages);
+
+	return 1;
+
+unlock:
+	xcic_intl_port_unlock(xp);
+
+except:
+	free(messages);
+
+	return lua_error(L);
+}
+
+int xcic_decode_series(lua_State *L)
+{
+	if (lua_gettop(L) < 2)
+		return luaL_error(L, "Usage: xcic.decode_series(data, count)");
+
+	size_t size;
+	const char *data = luaL_checklstring(L, 1, &size);
+	uint32_t count = luaL_checkinteger(L, 2);
+
+	struct xcic_series_iter it;
+	xcic_series_iter_create(&it, data, size, count);
+
+	lua_createtable(L, count, 0);
+
+	uint64_t ts;
+	double value;
+	int rc;
+
+	for (int i = 1; (rc = xcic_series_iter_next(&it, &ts, &value)) > 0; i++) {
+		lua_createtable(L, 2, 0);
+		lua_pushnumber(L, ts / 1000.0);
+		lua_rawseti(L, -2, 1);
+		lua_pushnumber(L, value);
+		lua_rawseti(L, -2, 2);
+		lua_rawseti(L, -2, i);
+	}
+
+	if (rc)
+		return luaL_error(L, "corrupt series block");
+
+	return 1;
+}
+
+int xcic_message_text(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: xcic.message_text(type)");
+
+	const char *text = xcic_intl_message_text(luaL_checkinteger(L, 1));
+
+	if (text)
+		lua_pushstring(L, text);
+	else
+		lua_pushnil(L);
+
+	return 1;
+}
+
+int xcic_port_read_datalog_dir(lua_State *L)
+{
+	if (lua_gettop(L) < 2)
+		return luaL_error(L, "Usage: xp:read_datalog_dir(dst_addr)");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+	uint32_t dst_addr = lua_tointeger(L, 2);
+	uint32_t object_id = 1; // directory list
+
+	struct ibuf rbuf __attribute__((cleanup(ibuf_destroy))) = {0};
+	ibuf_create(&rbuf, cord_slab_cache(), 4096);
+
+	struct xcic_xfer_sink sink = {.ibuf = &rbuf, .fd = -1};
+
+	xcic_intl_port_lock(xp, XCIC_PRIORITY_INTERACTIVE);
+	int ret = xcic_scom_xfer_datalog(L, xp, dst_addr, object_id, NULL, 0, &sink);
+	xcic_intl_port_unlock(xp);
+
+	if (ret)
+		goto except;
+
+	lua_pushlstring(L, rbuf.rpos, ibuf_used(&rbuf));
+
+	return 1;
+
+except:
+	return lua_error(L);
+}
+
+int xcic_port_read_datalog_file(lua_State *L)
+{
+	if (lua_gettop(L) < 3)
+		return luaL_error(L, "Usage: xp:read_datalog_file(dst_addr, filename)");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+	uint32_t dst_addr = lua_tointeger(L, 2);
+	uint32_t object_id = 2; // file access
+
+	size_t data_len;
+	const char *data = lua_tolstring(L, 3, &data_len);
+
+	struct ibuf rbuf __attribute__((cleanup(ibuf_destroy))) = {0};
+	ibuf_create(&rbuf, cord_slab_cache(), 4096);
+
+	struct xcic_xfer_sink sink = {.ibuf = &rbuf, .fd = -1};
+
+	xcic_intl_port_lock(xp, XCIC_PRIORITY_BULK);
+	int ret = xcic_scom_xfer_datalog(L, xp, dst_addr, object_id, data, data_len, &sink);
+	xcic_intl_port_unlock(xp);
+
+	if (ret)
+		goto except;
+
+	lua_pushlstring(L, rbuf.rpos, ibuf_used(&rbuf));
+
+	return 1;
+
+except:
+	return lua_error(L);
+}
+
+int xcic_port_stream_datalog_file(lua_State *L)
+{
+	if (lua_gettop(L) < 4 || !(lua_isfunction(L, 4) || lua_isnumber(L, 4)))
+		return luaL_error(L, "Usage: xp:stream_datalog_file(dst_addr, filename, "
+				     "callback | fd[, offset])");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+	uint32_t dst_addr = lua_tointeger(L, 2);
+	uint32_t object_id = 2; // file access
+
+	size_t data_len;
+	const char *data = lua_tolstring(L, 3, &data_len);
+
+	struct xcic_xfer_sink sink = {.fd = -1};
+
+	if (lua_isfunction(L, 4))
+		sink.callback = 4;
+	else
+		sink.fd = lua_tointeger(L, 4);
+
+	sink.offset = luaL_optinteger(L, 5, 0);
+
+	xcic_intl_port_lock(xp, XCIC_PRIORITY_BULK);
+	int ret = xcic_scom_xfer_datalog(L, xp, dst_addr, object_id, data, data_len, &sink);
+	xcic_intl_port_unlock(xp);
+
+	if (ret)
+		goto except;
+
+	lua_pushnumber(L, sink.length);
+
+	return 1;
+
+except:
+	return lua_error(L);
+}
+
+int xcic_port_read_datalog_index(lua_State *L)
+{
+	if (lua_gettop(L) < 2)
+		return luaL_error(L, "Usage: xp:read_datalog_index(dst_addr)");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+	uint32_t dst_addr = lua_tointeger(L, 2);
+	uint32_t object_id = 1; // directory list
+
+	struct ibuf rbuf __attribute__((cleanup(ibuf_destroy))) = {0};
+	ibuf_create(&rbuf, cord_slab_cache(), 4096);
+
+	struct xcic_xfer_sink sink = {.ibuf = &rbuf, .fd = -1};
+
+	xcic_intl_port_lock(xp, XCIC_PRIORITY_INTERACTIVE);
+	int ret = xcic_scom_xfer_datalog(L, xp, dst_addr, object_id, NULL, 0, &sink);
+	xcic_intl_port_unlock(xp);
+
+	if (ret)
+		goto except;
+
+	struct xcic_datalog_entry *entries;
+	size_t count;
+
+	if (xcic_datalog_dir_parse(rbuf.rpos, ibuf_used(&rbuf), &entries, &count))
+		xcic_lua_except(L, "alloc failed");
+
+	lua_createtable(L, count, 0);
+
+	for (size_t i = 0; i < count; i++) {
+		lua_createtable(L, 0, 3);
+
+		lua_pushstring(L, entries[i].name);
+		lua_setfield(L, -2, "name");
+
+		lua_pushnumber(L, entries[i].size);
+		lua_setfield(L, -2, "size");
+
+		lua_pushnumber(L, entries[i].mtime);
+		lua_setfield(L, -2, "mtime");
+
+		lua_rawseti(L, -2, i + 1);
+	}
+
+	free(entries);
+
+	return 1;
+
+except:
+	return lua_error(L);
+}
+
+int xcic_load_datalog(lua_State *L)
+{
+	if (lua_gettop(L) < 2)
+		return luaL_error(L, "Usage: xcic.load_datalog(space_id, csv)");
+
+	uint32_t space_id = luaL_checkinteger(L, 1);
+
+	size_t size;
+	const char *data = luaL_checklstring(L, 2, &size);
+
+	struct xcic_datalog log;
+	memset(&log, 0, sizeof(log));
+
+	char errmsg[XCIC_ERRMSG_SIZE_MAX];
+
+	if (coio_call(xcic_intl_datalog_parse_cb, &log, data, size))
+		xcic_lua_except(L, "datalog: %s", log.errmsg[0] ? log.errmsg : "parse failed");
+
+	if (xcic_intl_datalog_store(space_id, &log, errmsg, sizeof(errmsg)))
+		xcic_lua_except(L, "datalog: %s", errmsg);
+
+	lua_pushnumber(L, log.tuple_count);
+
+	xcic_datalog_destroy(&log);
+
+	return 1;
+
+except:
+	xcic_datalog_destroy(&log);
+
+	return lua_error(L);
+}
+
+/*
+ * Loads every *.csv file of a directory, parsing on coio threads while up to
+ * `workers` fibers store the results.
+ */
+int xcic_load_datalog_dir(lua_State *L)
+{
+	if (lua_gettop(L) < 2)
+		return luaL_error(L, "Usage: xcic.load_datalog_dir(space_id, dirname[, workers])");
+
+	struct xcic_datalog_job job;
+	memset(&job, 0, sizeof(job));
+
+	job.space_id = luaL_checkinteger(L, 1);
+	job.dirname = luaL_checkstring(L, 2);
+
+	lua_Integer workers = luaL_optinteger(L, 3, 4);
+	if (workers < 1 || workers > XCIC_DATALOG_WORKERS_MAX)
+		return luaL_error(L, "invalid number of workers");
+
+	struct fiber *fibers[XCIC_DATALOG_WORKERS_MAX];
+
+	if (coio_call(xcic_intl_datalog_list_cb, job.dirname, &job.names, &job.count))
+		xcic_lua_except(L, "opendir: %s", strerror(errno));
+
+	job.stored = (ssize_t *)calloc(job.count ?: 1, sizeof(*job.stored));
+	job.errmsgs = calloc(job.count ?: 1, sizeof(*job.errmsgs));
+	if (!job.stored || !job.errmsgs)
+		xcic_lua_except(L, "alloc failed");
+
+	if ((size_t)workers > job.count)
+		workers = job.count;
+
+	for (lua_Integer i = 0; i < workers; i++) {
+		fibers[i] = fiber_new("xcic_datalog", xcic_intl_datalog_worker_f);
+		if (!fibers[i]) {
+			workers = i;
+			break;
+		}
+
+		fiber_set_joinable(fibers[i], true);
+		fiber_start(fibers[i], &job);
+	}
+
+	for (lua_Integer i = 0; i < workers; i++)
+		fiber_join(fibers[i]);
+
+	lua_createtable(L, 0, job.count);
+
+	for (size_t i = 0; i < job.count; i++) {
+		if (job.stored[i] >= 0)
+			lua_pushnumber(L, job.stored[i]);
+		else
+			lua_pushstring(L, job.errmsgs[i]);
+		lua_setfield(L, -2, job.names[i]);
+	}
+
+	for (size_t i = 0; i < job.count; i++)
+		free(job.names[i]);
+	free(job.names);
+	free(job.stored);
+	free(job.errmsgs);
+
+	return 1;
+
+except:
+	for (size_t i = 0; i < job.count; i++)
+		free(job.names[i]);
+	free(job.names);
+	free(job.stored);
+	free(job.errmsgs);
+
+	return lua_error(L);
+}
+
+int xcic_port_start_poller(lua_State *L)
+{
+	if (lua_gettop(L) < 2 || !lua_istable(L, 2))
+		return luaL_error(L, "Usage: xp:start_poller({{dst_addr, object_type, "
+				     "object_id, property_id[, period = s][, priority = n]"
+				     "[, timeout = s][, series = id]}, ...}[, interval])");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+
+	if (xp->poller)
+		return luaL_error(L, "poller is already running");
+
+	struct xcic_poller *poller = (struct xcic_poller *)calloc(1, sizeof(*poller));
+	if (!poller)
+		return luaL_error(L, "alloc failed");
+
+	poller->L_ref = LUA_NOREF;
+	poller->port_ref = LUA_NOREF;
+	poller->interval = luaL_optnumber(L, 3, 1.0);
+
+	if (xcic_intl_poll_list_parse(L, 2, xp->name, poller->interval, &poller->entries,
+				      &poller->entry_count))
+		goto except;
+
+	poller->fiber = fiber_new("xcic_poller", xcic_intl_poller_f);
+	if (!poller->fiber)
+		xcic_lua_except(L, "fiber_new failed");
+
+	poller->L = lua_newthread(L);
+	poller->L_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	lua_pushvalue(L, 1);
+	poller->port_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	xp->poller = poller;
+
+	fiber_set_joinable(poller->fiber, true);
+	fiber_start(poller->fiber, xp);
+
+	return 0;
+
+except:
+	xcic_intl_poller_delete(L, poller);
+
+	return lua_error(L);
+}
+
+int xcic_port_stop_poller(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: xp:stop_poller()");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+
+	xcic_intl_poller_stop(L, xp);
+
+	return 0;
+}
+
+int xcic_port_reload_poller(lua_State *L)
+{
+	if (lua_gettop(L) < 2 || !lua_istable(L, 2))
+		return luaL_error(L, "Usage: xp:reload_poller({{dst_addr, object_type, "
+				     "object_id, property_id[, period = s][, priority = n]"
+				     "[, timeout = s][, series = id]}, ...}[, interval])");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+	struct xcic_poller *poller = xp->poller;
+
+	if (!poller)
+		return luaL_error(L, "poller is not running");
+
+	double interval = luaL_optnumber(L, 3, poller->interval);
+
+	struct xcic_poll_entry *entries;
+	size_t entry_count;
+
+	if (xcic_intl_poll_list_parse(L, 2, xp->name, interval, &entries, &entry_count))
+		return lua_error(L);
+
+	/* carry the known values over so the snapshot does not go blank */
+	for (size_t i = 0; i < entry_count; i++) {
+		struct xcic_poll_entry *old = xcic_intl_poll_entry_find(poller, &entries[i]);
+		if (!old)
+			continue;
+
+		xcic_intl_poll_entry_commit(&entries[i], old);
+		entries[i].missed = old->missed;
+		if (old->due < entries[i].due + entries[i].period)
+			entries[i].due = old->due;
+
+		if (old->series_id == entries[i].series_id) {
+			entries[i].series = old->series;
+			old->series = NULL;
+		}
+	}
+
+	for (size_t i = 0; i < poller->entry_count; i++)
+		xcic_intl_series_flush(xp, &poller->entries[i]);
+
+	xcic_intl_poll_list_free(poller->entries, poller->entry_count);
+
+	poller->entries = entries;
+	poller->entry_count = entry_count;
+	poller->interval = interval;
+	poller->plan_version++;
+
+	if (poller->idle)
+		fiber_wakeup(poller->fiber);
+
+	return 0;
+}
+
+int xcic_port_snapshot(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: xp:snapshot()");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+	struct xcic_poller *poller = xp->poller;
+
+	if (!poller)
+		return luaL_error(L, "poller is not running");
+
+	lua_createtable(L, poller->entry_count, 3);
+
+	lua_pushnumber(L, poller->generation);
+	lua_setfield(L, -2, "generation");
+	lua_pushnumber(L, poller->ts);
+	lua_setfield(L, -2, "ts");
+	lua_pushnumber(L, poller->missed);
+	lua_setfield(L, -2, "missed");
+
+	for (size_t i = 0; i < poller->entry_count; i++) {
+		xcic_intl_poll_entry_push(L, &poller->entries[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+
+	return 1;
+}
+
+int xcic_port(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: xcic.port(name)");
+
+	struct xcic_port *xp = xcic_intl_port_find(luaL_checkstring(L, 1));
+
+	if (!xp)
+		return 0;
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, xp->self_ref);
+
+	return 1;
+}
+
+int xcic_ports(lua_State *L)
+{
+	struct xcic_port *xp;
+
+	lua_newtable(L);
+
+	rlist_foreach_entry(xp, &xcic_port_registry, link) {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, xp->self_ref);
+		lua_setfield(L, -2, xp->name);
+	}
+
+	return 1;
+}
+
+/*
+ * Snapshots of all the registered ports with a poller, in one list. Items are
+ * labelled with the port name and their index in that port's poll plan.
+ */
+int xcic_merged_snapshot(lua_State *L)
+{
+	struct xcic_port *xp;
+	int n = 0;
+
+	lua_newtable(L);
+	lua_newtable(L); // ports
+
+	rlist_foreach_entry(xp, &xcic_port_registry, link) {
+		struct xcic_poller *poller = xp->poller;
+
+		if (!poller)
+			continue;
+
+		lua_createtable(L, 0, 3);
+		lua_pushnumber(L, poller->generation);
+		lua_setfield(L, -2, "generation");
+		lua_pushnumber(L, poller->ts);
+		lua_setfield(L, -2, "ts");
+		lua_pushnumber(L, poller->missed);
+		lua_setfield(L, -2, "missed");
+		lua_setfield(L, -2, xp->name);
+
+		for (size_t i = 0; i < poller->entry_count; i++) {
+			xcic_intl_poll_entry_push(L, &poller->entries[i]);
+			lua_pushstring(L, xp->name);
+			lua_setfield(L, -2, "port");
+			lua_pushinteger(L, i + 1);
+			lua_setfield(L, -2, "index");
+			lua_rawseti(L, -3, ++n);
+		}
+	}
+
+	lua_setfield(L, -2, "ports");
+
+	return 1;
+}
+
+/*
+ * Prometheus text exposition of the values polled on all the registered
+ * ports. Names are prepared with the plan, the text goes to a buffer kept
+ * from one scrape to the next, so a scrape allocates nothing but the result
+ * string. Samples carry the time their response was received.
+ */
+int xcic_render_metrics(lua_State *L)
+{
+	static struct ibuf buf;
+	static const struct xcic_poll_entry **sorted;
+	static size_t sorted_capacity;
+
+	struct xcic_port *xp;
+	size_t n = 0;
+
+	if (!buf.slabc)
+		ibuf_create(&buf, cord_slab_cache(), 16384);
+
+	ibuf_reset(&buf);
+
+	rlist_foreach_entry(xp, &xcic_port_registry, link) {
+		if (xp->poller)
+			n += xp->poller->entry_count;
+	}
+
+	if (n > sorted_capacity) {
+		const struct xcic_poll_entry **tmp =
+		    (const struct xcic_poll_entry **)realloc(sorted, n * sizeof(*tmp));
+		if (!tmp)
+			return luaL_error(L, "alloc failed");
+
+		sorted = tmp;
+		sorted_capacity = n;
+	}
+
+	n = 0;
+
+	rlist_foreach_entry(xp, &xcic_port_registry, link) {
+		if (!xp->poller)
+			continue;
+
+		for (size_t i = 0; i < xp->poller->entry_count; i++) {
+			const struct xcic_poll_entry *e = &xp->poller->entries[i];
+
+			if (e->metric && e->object && e->version &&
+			    e->last_error == SCOM_ERROR_NO_ERROR)
+				sorted[n++] = e;
+		}
+	}
+
+	/* samples of a family must come together */
+	qsort(sorted, n, sizeof(*sorted), xcic_intl_metric_cmp);
+
+	const struct xcic_poll_entry *family = NULL;
+
+	for (size_t i = 0; i < n; i++) {
+		const struct xcic_poll_entry *e = sorted[i];
+		double value;
+
+		if (xcic_intl_object_number(e->object, e->value, &value))
+			continue;
+
+		char *p = (char *)ibuf_reserve(&buf, 2 * strlen(e->metric) + 64);
+		if (!p)
+			return luaL_error(L, "alloc failed");
+
+		if (!family || family->family_length != e->family_length ||
+		    memcmp(family->metric, e->metric, e->family_length)) {
+			p += sprintf(p, "# TYPE %.*s gauge\n", (int)e->family_length, e->metric);
+			family = e;
+		}
+
+		p += sprintf(p, "%s %.10g %" PRIu64 "\n", e->metric, value,
+			     (uint64_t)(e->ts * 1000));
+
+		buf.wpos = p;
+	}
+
+	static const char *const port_metrics[] = {
+	    "xci_poll_deadline_misses",
+	    "xci_poll_generation",
+	};
+
+	for (size_t m = 0; m < SCOM_NBR_ELEMENTS(port_metrics); m++) {
+		bool type_done = false;
+
+		rlist_foreach_entry(xp, &xcic_port_registry, link) {
+			if (!xp->poller)
+				continue;
+
+			char *p = (char *)ibuf_reserve(&buf, 2 * strlen(xp->name) + 128);
+			if (!p)
+				return luaL_error(L, "alloc failed");
+
+			if (!type_done) {
+				p += sprintf(p, "# TYPE %s counter\n", port_metrics[m]);
+				type_done = true;
+			}
+
+			uint64_t value = m == 0 ? xp->poller->missed : xp->poller->generation;
+			p += sprintf(p, "%s{port=\"%s\"} %" PRIu64 "\n", port_metrics[m], xp->name,
+				     value);
+
+			buf.wpos = p;
+		}
+	}
+
+	if (xcic_intl_stats_render(&buf))
+		return luaL_error(L, "alloc failed");
+
+	lua_pushlstring(L, buf.rpos, ibuf_used(&buf));
+
+	return 1;
+}
+
+int xcic_port_subscribe(lua_State *L)
+{
+	if (lua_gettop(L) < 2 || !lua_istable(L, 2))
+		return luaL_error(L, "Usage: xp:subscribe({dst_addr, object_type, object_id, "
+				     "property_id}[, deadband[, size]])");
+
+	struct xcic_port *xp = (struct xcic_port *)luaL_checkudata(L, 1, XCIC_PORT_LUA_UDATA_NAME);
+
+	double deadband = luaL_optnumber(L, 3, 0);
+	lua_Integer size = luaL_optinteger(L, 4, 64);
+
+	if (size < 1)
+		return luaL_error(L, "invalid subscription size");
+
+	lua_rawgeti(L, 2, 1);
+	lua_rawgeti(L, 2, 2);
+	lua_rawgeti(L, 2, 3);
+	lua_rawgeti(L, 2, 4);
+
+	struct xcic_subscription *sub =
+	    (struct xcic_subscription *)lua_newuserdata(L, sizeof(*sub));
+
+	memset(sub, 0, sizeof(*sub));
+	rlist_create(&sub->link);
+	sub->port_ref = LUA_NOREF;
+
+	luaL_getmetatable(L, XCIC_SUBSCRIPTION_LUA_UDATA_NAME);
+	lua_setmetatable(L, -2);
+
+	sub->dst_addr = lua_tointeger(L, -5);
+	sub->object_type = lua_tointeger(L, -4);
+	sub->object_id = lua_tointeger(L, -3);
+	sub->property_id = lua_isnil(L, -2) ? 1 : lua_tointeger(L, -2);
+	sub->object = xcic_intl_object_find(sub->object_type, sub->object_id);
+	sub->deadband = deadband;
+	sub->error = SCOM_ERROR_NO_ERROR;
+	sub->capacity = size;
+
+	sub->events = (struct xcic_event *)calloc(sub->capacity, sizeof(*sub->events));
+	sub->cond = fiber_cond_new();
+	if (!sub->events || !sub->cond)
+		return luaL_error(L, "alloc failed");
+
+	lua_pushvalue(L, 1);
+	sub->port_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	sub->xp = xp;
+	rlist_add_tail(&xp->subscriptions, &sub->link);
+
+	/* start off with the value the poller already knows */
+	if (xp->poller) {
+		struct xcic_poll_entry key = {
+		    .dst_addr = sub->dst_addr,
+		    .object_type = sub->object_type,
+		    .object_id = sub->object_id,
+		    .property_id = sub->property_id,
+		};
+		struct xcic_poll_entry *entry = xcic_intl_poll_entry_find(xp->poller, &key);
+		if (entry && (entry->version || entry->last_error != SCOM_ERROR_NO_ERROR))
+			xcic_intl_subscription_notify(sub, entry);
+	}
+
+	return 1;
+}
+
+int xcic_subscription_get(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: sub:get([timeout])");
+
+	struct xcic_subscription *sub = (struct xcic_subscription *)luaL_checkudata(
+	    L, 1, XCIC_SUBSCRIPTION_LUA_UDATA_NAME);
+
+	double timeout = luaL_optnumber(L, 2, TIMEOUT_INFINITY);
+	double deadline = fiber_clock() + timeout;
+
+	while (!sub->count) {
+		double left = deadline - fiber_clock();
+
+		if (!sub->xp || left <= 0)
+			return 0;
+
+		if (fiber_cond_wait_timeout(sub->cond, left) && fiber_is_cancelled())
+			return 0;
+	}
+
+	struct xcic_event *event = &sub->events[sub->head];
+
+	sub->head = (sub->head + 1) % sub->capacity;
+	sub->count--;
+
+	lua_createtable(L, 0, 3);
+
+	if (event->error == SCOM_ERROR_NO_ERROR) {
+		if (sub->object)
+			xcic_intl_object_push(L, sub->object, event->value);
+		else
+			lua_pushlstring(L, event->value, event->value_length);
+		lua_setfield(L, -2, "value");
+		lua_pushnumber(L, event->version);
+		lua_setfield(L, -2, "version");
+	} else {
+		lua_pushstring(L, event->errmsg);
+		lua_setfield(L, -2, "error");
+	}
+
+	lua_pushnumber(L, event->ts);
+	lua_setfield(L, -2, "ts");
+
+	return 1;
+}
+
+int xcic_subscription_count(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: sub:count()");
+
+	struct xcic_subscription *sub = (struct xcic_subscription *)luaL_checkudata(
+	    L, 1, XCIC_SUBSCRIPTION_LUA_UDATA_NAME);
+
+	lua_pushinteger(L, sub->count);
+
+	return 1;
+}
+
+int xcic_subscription_dropped(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: sub:dropped()");
+
+	struct xcic_subscription *sub = (struct xcic_subscription *)luaL_checkudata(
+	    L, 1, XCIC_SUBSCRIPTION_LUA_UDATA_NAME);
+
+	lua_pushnumber(L, sub->dropped);
+
+	return 1;
+}
+
+int xcic_subscription_is_closed(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: sub:is_closed()");
+
+	struct xcic_subscription *sub = (struct xcic_subscription *)luaL_checkudata(
+	    L, 1, XCIC_SUBSCRIPTION_LUA_UDATA_NAME);
+
+	lua_pushboolean(L, sub->xp == NULL);
+
+	return 1;
+}
+
+int xcic_subscription_close(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: sub:close()");
+
+	struct xcic_subscription *sub = (struct xcic_subscription *)luaL_checkudata(
+	    L, 1, XCIC_SUBSCRIPTION_LUA_UDATA_NAME);
+
+	xcic_intl_subscription_detach(L, sub);
+
+	return 0;
+}
+
+int xcic_subscription_gc(lua_State *L)
+{
+	struct xcic_subscription *sub = (struct xcic_subscription *)luaL_checkudata(
+	    L, 1, XCIC_SUBSCRIPTION_LUA_UDATA_NAME);
+
+	xcic_intl_subscription_detach(L, sub);
+
+	if (sub->cond)
+		fiber_cond_delete(sub->cond);
+	sub->cond = NULL;
+
+	free(sub->events);
+	sub->events = NULL;
+
+	return 0;
+}
+
+enum xcic_xfer_state {
+	XCIC_XFER_START = 0x21,	   /*SD_Start*/
+	XCIC_XFER_CONTINUE = 0x23, /*SD_Ack_Continue*/
+	XCIC_XFER_RETRY = 0x24,	   /*SD_Nack_Retry*/
+	XCIC_XFER_ABORT = 0x25,	   /*SD_Abort*/
+};
+
+int xcic_scom_xfer_datalog(lua_State *L, struct xcic_port *xp, uint32_t dst_addr,
+			   uint32_t object_id, const char *data, size_t data_len,
+			   struct xcic_xfer_sink *sink)
+{
+	scom_frame_t frame;
+	scom_property_t property;
+
+	enum xcic_xfer_state xfst = XCIC_XFER_START;
+	int retries = 0;
+
+	for (;;) {
+		/* the device keeps the transfer open, others may go in between blocks */
+		if (xfst != XCIC_XFER_START)
+			xcic_intl_port_yield(xp);
+
+		scom_initialize_frame(&frame, NULL, 0);
+		frame.src_addr = 1;
+		frame.dst_addr = dst_addr;
+
+		scom_initialize_property(&property, &frame);
+		property.object_type = 0x101; // datalog transfer
+		property.object_id = object_id;
+		property.property_id = (uint32_t)xfst;
+
+		say_debug(" -> xfst 0x%x prop 0x%x data `%.*s`", xfst, property.property_id,
+			  (int)data_len, data);
+
+		if (xcic_scom_read_property(L, xp, &xp->ibuf, &property, data, data_len))
+			switch (xfst) {
+			case XCIC_XFER_ABORT:
+				lua_pop(L, 1); // drop last error
+				goto except;
+			case XCIC_XFER_CONTINUE:
+			case XCIC_XFER_RETRY:
+				/* the device keeps its place, ask for the block again */
+				if (retries++ == XCIC_XFER_RETRIES)
+					goto abort; // error saved
+				say_debug("xcic: datalog block retry %d at %zu", retries,
+					  sink->length);
+				lua_pop(L, 1); // drop last error
+				xfst = XCIC_XFER_RETRY;
+				continue;
+			default:
+				goto abort; // error saved
+			}
+
+		retries = 0;
+
+		if (xfst == XCIC_XFER_ABORT)
+			goto except;
+
+		say_debug("<-  xfst 0x%x prop 0x%x vl %zu rl %zu", xfst, property.property_id,
+			  property.value_length, sink->length);
+
+		if (property.value_length &&
+		    xcic_intl_xfer_sink_put(L, sink, property.value_buffer, property.value_length))
+			goto abort; // error saved
+
+		xfst = XCIC_XFER_CONTINUE;
+		if (property.property_id == 0x22 /*SD_Datablock*/)
+			continue;
+		else if (property.property_id == 0x26 /*SD_Finish*/)
+			break;
+
+	abort:
+		xfst = XCIC_XFER_ABORT;
+	}
+
+	return 0;
+
+except:
+	return -1; // caller must invoke `lua_error'
+}
+
+int xcic_scom_port_exchange(lua_State *L, struct xcic_port *xp, struct ibuf *ibuf,
+			    scom_frame_t *frame)
+{
+	ssize_t nb;
+	struct xcic_ring_slot *slot = NULL;
+
+	uint32_t dst_addr = frame->dst_addr;
+	scom_object_type_t object_type =
+	    scom_read_le16(&frame->buffer[SCOM_FRAME_HEADER_SIZE + 2]);
+
+	double timeout = xp->timeout > 0 ? xp->timeout : xp->response_timeout;
+	xp->timeout = 0;
+
+	xp->stats.requests++;
+
+	if (!xp->pathname) {
+		frame->last_error = SCOM_ERROR_STACK_PORT_NOT_FOUND;
+		xcic_lua_except(L, "port is closed");
+	}
+
+	if (xp->fd == -1) {
+		if (xcic_intl_port_open(L, xp, xp->pathname)) {
+			frame->last_error = SCOM_ERROR_STACK_PORT_INIT_FAILED;
+			goto except;
+		}
+
+		say_info("xcic: reopened %s (%d)", xp->pathname, xp->fd);
+		xp->stats.reopens++;
+	}
+
+	/* whatever is still pending answers an earlier request */
+	xp->rx_skipped += ibuf_used(&xp->rx);
+	ibuf_reset(&xp->rx);
+	(void)tcflush(xp->fd, TCIFLUSH);
+
+	double started = fiber_clock();
+
+	slot = xcic_intl_ring_record(xp, frame->buffer, scom_frame_length(frame));
+
+	nb = xcic_intl_port_write(xp, frame->buffer, scom_frame_length(frame), timeout);
+
+	/*
+	 * A cancelled fiber leaves the port open: the next exchange flushes
+	 * what is pending and resynchronises on the start byte.
+	 */
+	if (nb == -1 && errno == ECANCELED) {
+		frame->last_error = XCIC_ERROR_CANCELLED;
+		xcic_lua_except(L, "cancelled when writing to the com port");
+	}
+
+	if (nb != (ssize_t)scom_frame_length(frame)) {
+		frame->last_error = SCOM_ERROR_STACK_PORT_WRITE_FAILED;
+		xcic_intl_port_close(xp);
+		xcic_lua_except(L, "error when writing to the com port");
+	}
+
+	nb = xcic_intl_port_recv_frame(xp, dst_addr, timeout);
+
+	if (nb == -1 && errno == ETIMEDOUT) {
+		frame->last_error = SCOM_ERROR_RESPONSE_TIMEOUT;
+		xcic_lua_except(L, "timeout when reading the response from the com port");
+	}
+
+	if (nb == -1 && errno == ECANCELED) {
+		frame->last_error = XCIC_ERROR_CANCELLED;
+		xcic_lua_except(L, "cancelled when reading the response from the com port");
+	}
+
+	if (nb == -1) {
+		frame->last_error = SCOM_ERROR_STACK_PORT_READ_FAILED;
+		xcic_intl_port_close(xp);
+		xcic_lua_except(L, "error when reading the response from the com port");
+	}
+
+	xcic_intl_stats_latency(xp, dst_addr, object_type, fiber_clock() - started);
+
+	if (slot) {
+		slot->latency = fiber_clock() - started;
+		slot->response_length = nb;
+		memcpy(slot->response, xp->rx.rpos, XCIC_MIN((size_t)nb, sizeof(slot->response)));
+	}
+
+	ibuf_reset(ibuf);
+
+	if (!ibuf_alloc(ibuf, nb)) {
+		frame->last_error = SCOM_ERROR_STACK_BUFFER_TOO_SMALL;
+		xcic_lua_except(L, "alloc failed");
+	}
+
+	memcpy(ibuf->rpos, xp->rx.rpos, nb);
+	xp->rx.rpos += nb;
+
+	scom_initialize_frame(frame, ibuf->rpos, ibuf_used(ibuf));
+
+	if (xcic_scom_decode_frame_header(L, frame))
+		goto except;
+
+	return 0;
+
+except:
+	if (slot)
+		slot->error = frame->last_error;
+
+	if (frame->last_error != SCOM_ERROR_NO_ERROR) {
+		char code[2];
+		scom_write_le16(code, frame->last_error);
+		xcic_intl_capture(xp, XCIC_CAPTURE_ERROR, code, sizeof(code));
+	}
+
+	return -1; // caller must invoke `lua_error`
+}
+
+void xcic_scom_dump_faulty_frame(struct ibuf *ibuf, scom_frame_t *frame)
+{
+	size_t len = scom_frame_length(frame);
+	char *esc = (char *)static_reserve(len * 4 + 1);
+
+	if (esc) {
+		char *ptr = esc;
+		for (size_t i = 0; i < scom_frame_length(frame); i++)
+			ptr += sprintf(ptr, "\\%d", (uint8_t)frame->buffer[i]);
+
+		*ptr = '\0';
+	}
+
+	uint16_t cs =
+	    xcic_codec_calc_checksum(&frame->buffer[SCOM_FRAME_HEADER_SIZE], frame->data_length);
+
+	say_info("xcic: faulty frame len %d iu %d cs %d esc %s", len, ibuf_used(ibuf), cs,
+		 esc ?: "-");
+}
+
+int xcic_scom_encode_read_property(lua_State *L, struct ibuf *ibuf, scom_property_t *property,
+				   const char *data, size_t data_len)
+{
+	if (xcic_codec_encode_read_property(ibuf, property, data, data_len))
+		xcic_lua_except(L, "read property frame encoding failed with error %d (%s)",
+				property->frame->last_error,
+				xcic_codec_strerror(property->frame->last_error));
+
+	return 0;
+
+except:
+	return -1; // caller must invoke `lua_error`
+}
+
+int xcic_scom_encode_write_property(lua_State *L, struct ibuf *ibuf, scom_property_t *property,
+				    const char *data, size_t data_len)
+{
+	if (xcic_codec_encode_write_property(ibuf, property, data, data_len))
+		xcic_lua_except(L, "write property frame encoding failed with error %d (%s)",
+				property->frame->last_error,
+				xcic_codec_strerror(property->frame->last_error));
+
+	return 0;
+
+except:
+	return -1; // caller must invoke `lua_error`
+}
+
+int xcic_scom_encode_request_frame(lua_State *L, struct ibuf *ibuf, scom_frame_t *frame)
+{
+	if (xcic_codec_encode_request_frame(ibuf, frame))
+		xcic_lua_except(L, "data link frame encoding failed with error %d (%s)",
+				frame->last_error, xcic_codec_strerror(frame->last_error));
+
+	return 0;
+
+except:
+	return -1; // caller must invoke `lua_error`
+}
+
+int xcic_scom_decode_frame_header(lua_State *L, scom_frame_t *frame)
+{
+	scom_decode_frame_header(frame);
+
+	if (frame->last_error != SCOM_ERROR_NO_ERROR)
+		xcic_lua_except(L, "data link header decoding failed with error %d (%s)",
+				frame->last_error, xcic_codec_strerror(frame->last_error));
+
+	return 0;
+
+except:
+	return -1; // caller must invoke `lua_error`
+}
+
+int xcic_scom_decode_frame_data(lua_State *L, scom_frame_t *frame)
+{
+	scom_decode_frame_data(frame);
+
+	if (frame->last_error != SCOM_ERROR_NO_ERROR)
+		xcic_lua_except(L, "data link data decoding failed with error %d (%s)",
+				frame->last_error, xcic_codec_strerror(frame->last_error));
+
+	return 0;
+
+except:
+	return -1; // caller must invoke `lua_error`
+}
+
+int xcic_scom_decode_read_property(lua_State *L, scom_property_t *property)
+{
+	scom_decode_read_property(property);
+
+	if (property->frame->last_error != SCOM_ERROR_NO_ERROR)
+		xcic_lua_except(L, "read property decoding failed with error %d (%s)",
+				property->frame->last_error,
+				xcic_codec_strerror(property->frame->last_error));
+
+	return 0;
+
+except:
+	return -1; // caller must invoke `lua_error`
+}
+
+int xcic_scom_decode_write_property(lua_State *L, scom_property_t *property)
+{
+	scom_decode_write_property(property);
+
+	if (property->frame->last_error != SCOM_ERROR_NO_ERROR)
+		xcic_lua_except(L, "write property decoding failed with error %d (%s)",
+				property->frame->last_error,
+				xcic_codec_strerror(property->frame->last_error));
+
+	return 0;
+
+except:
+	return -1; // caller must invoke `lua_error`
+}
+
+int xcic_pack_le32(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: xcic.pack_le32(val)");
+
+	uint32_t val;
+	scom_write_le32((char *const) & val, (uint32_t)lua_tointeger(L, 1));
+
+	lua_pushlstring(L, (const char *)&val, 4);
+
+	return 1;
+}
+
+int xcic_unpack_le32(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: xcic.unpack_le32(data)");
+
+	size_t data_len;
+	const char *data = lua_tolstring(L, 1, &data_len);
+
+	if (data_len != 4)
+		xcic_lua_except(L, "invalid le32 length %d", data_len);
+
+	lua_pushinteger(L, scom_read_le32(data));
+
+	return 1;
+
+except:
+	return lua_error(L);
+}
+
+int xcic_pack_le16(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: xcic.pack_le16(val)");
+
+	uint16_t val;
+	scom_write_le16((char *const) & val, (uint16_t)lua_tointeger(L, 1));
+
+	lua_pushlstring(L, (const char *)&val, 2);
+
+	return 1;
+}
+
+int xcic_unpack_le16(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: xcic.unpack_le16(data)");
+
+	size_t data_len;
+	const char *data = lua_tolstring(L, 1, &data_len);
+
+	if (data_len != 2)
+		xcic_lua_except(L, "invalid le16 length %d", data_len);
+
+	lua_pushinteger(L, scom_read_le16(data));
+
+	return 1;
+
+except:
+	return lua_error(L);
+}
+
+int xcic_pack_le_float(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: xcic.pack_le_float(val)");
+
+	uint32_t val;
+	scom_write_le_float((char *const) & val, (float)lua_tonumber(L, 1));
+
+	lua_pushlstring(L, (const char *)&val, 4);
+
+	return 1;
+}
+
+int xcic_unpack_le_float(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: xcic.unpack_le_float(data)");
+
+	size_t data_len;
+	const char *data = lua_tolstring(L, 1, &data_len);
+
+	if (data_len != 4)
+		xcic_lua_except(L, "invalid le float length %d", data_len);
+
+	lua_pushnumber(L, (lua_Number)scom_read_le_float(data));
+
+	return 1;
+
+except:
+	return lua_error(L);
+}
+
+int xcic_pack_bool(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: xcic.pack_bool(val)");
+
+	uint8_t val = (uint8_t)lua_toboolean(L, 1);
+
+	lua_pushlstring(L, (const char *)&val, 1);
+
+	return 1;
+}
+
+int xcic_unpack_bool(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: xcic.unpack_bool(data)");
+
+	size_t data_len;
+	const char *data = lua_tolstring(L, 1, &data_len);
+
+	if (data_len != 1)
+		xcic_lua_except(L, "invalid bool length %d", data_len);
+
+	lua_pushboolean(L, *data);
+
+	return 1;
+
+except:
+	return lua_error(L);
+}
+
+int xcic_pack_signal(lua_State *L)
+{
+	uint32_t val = 1;
+
+	lua_pushlstring(L, (const char *)&val, 4);
+
+	return 1;
+}
+
+int xcic_unpack_software_version(lua_State *L)
+{
+	if (lua_gettop(L) < 1)
+		return luaL_error(L, "Usage: xcic.unpack_software_version(msb_data, lsb_data)");
+
+	size_t msb_data_len;
+	const char *msb_data = lua_tolstring(L, 1, &msb_data_len);
+
+	if (msb_data_len != 4)
+		xcic_lua_except(L, "invalid msb data length %d", msb_data_len);
+
+	size_t lsb_data_len;
+	const char *lsb_data = lua_tolstring(L, 2, &lsb_data_len);
+
+	if (lsb_data_len != 4)
+		xcic_lua_except(L, "invalid lsb data length %d", lsb_data_len);
+
+	uint16_t msb = (uint16_t)scom_read_le_float(msb_data);
+	uint16_t lsb = (uint16_t)scom_read_le_float(lsb_data);
+
+	lua_pushfstring(L, "%d.%d.%d", msb >> 8, lsb >> 8, lsb & 0xFF);
+
+	return 1;
+
+except:
+	return lua_error(L);
+}
+
+/*
+ * Hunts the receive window for a response from `src_addr`: skips to the next
+ * start byte, steps over bytes whose header checksum does not hold and drops
+ * complete frames of other devices. On success the frame of the returned
+ * length starts at `xp->rx.rpos`.
+ *
+ * Waits until `timeout` for the response to start and, once a header from
+ * `src_addr` is coming in, at least `xp->byte_timeout` past the last byte
+ * received. Garbage and frames of other devices do not extend the wait, and
+ * no response takes longer than the largest frame past `timeout`; fails with
+ * ETIMEDOUT then.
+ */
+ssize_t xcic_intl_port_recv_frame(struct xcic_port *xp, uint32_t src_addr, double timeout)
+{
+	struct ibuf *rx = &xp->rx;
+
+	double response_deadline = fiber_clock() + timeout;
+	double cap = response_deadline + XCIC_FRAME_TIME_MAX;
+	double received = 0;
+
+	for (;;) {
+		char *start = NULL;
+		if (ibuf_used(rx))
+			start = (char *)memchr(rx->rpos, XCIC_FRAME_START_BYTE, ibuf_used(rx));
+		if (!start)
+			start = rx->wpos;
+
+		xp->rx_skipped += start - rx->rpos;
+		rx->rpos = start;
+
+		/* a start byte at the window head or a header of the awaited device */
+		bool flowing = ibuf_used(rx) > 0;
+
+		if (ibuf_used(rx) >= SCOM_FRAME_HEADER_SIZE) {
+			size_t data_length = scom_read_le16(&rx->rpos[10]);
+
+			if (xcic_codec_calc_checksum(&rx->rpos[1], SCOM_FRAME_HEADER_SIZE - 3) !=
+				scom_read_le16(&rx->rpos[12]) ||
+			    data_length > XCIC_FRAME_DATA_SIZE_MAX) {
+				xp->stats.checksum_errors++;
+				xp->rx_skipped++;
+				rx->rpos++;
+				continue;
+			}
+
+			size_t length = SCOM_FRAME_HEADER_SIZE + data_length + 2;
+
+			if (ibuf_used(rx) >= length) {
+				if (scom_read_le32(&rx->rpos[2]) == src_addr)
+					return length;
+
+				say_debug("xcic: dropped a frame from %u",
+					  scom_read_le32(&rx->rpos[2]));
+				xp->rx_dropped++;
+				rx->rpos += length;
+				continue;
+			}
+
+			flowing = scom_read_le32(&rx->rpos[2]) == src_addr;
+		}
+
+		if (fiber_is_cancelled()) {
+			errno = ECANCELED;
+			return -1;
+		}
+
+		if (xp->fd == -1) {
+			errno = EINTR;
+			return -1;
+		}
+
+		double deadline = response_deadline;
+		if (flowing && received + xp->byte_timeout > deadline)
+			deadline = received + xp->byte_timeout;
+		if (deadline > cap)
+			deadline = cap;
+
+		double left = deadline - fiber_clock();
+		if (left <= 0) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+
+		int w = coio_wait(xp->fd, COIO_READ, left);
+		if (!(w & COIO_READ))
+			continue;
+
+		void *p = ibuf_reserve(rx, 256);
+		if (!p) {
+			errno = ENOMEM;
+			return -1;
+		}
+
+		ssize_t n = read(xp->fd, p, ibuf_unused(rx));
+
+		if (n == 0) {
+			errno = EIO;
+			return -1;
+		} else if (n == -1 && errno == EAGAIN) {
+			continue;
+		} else if (n == -1) {
+			return -1;
+		}
+
+		xcic_intl_capture(xp, XCIC_CAPTURE_RX, rx->wpos, n);
+		xp->stats.bytes_in += n;
+
+		rx->wpos += n;
+		xp->rx_ts = clock_realtime();
+		received = fiber_clock();
+	}
+}
+
+ssize_t xcic_intl_port_write(struct xcic_port *xp, void *buf, size_t count, double timeout)
+{
+	size_t l = count;
+	ssize_t n = 0;
+	void *p = buf;
+
+	double deadline = fiber_clock() + timeout;
+
+	while (l > 0) {
+		if (xp->fd == -1)
+			break;
+
+		double left = deadline - fiber_clock();
+		if (left <= 0) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+
+		int w = coio_wait(xp->fd, COIO_WRITE, left);
+		if (fiber_is_cancelled()) {
+			errno = ECANCELED;
+			return -1;
+		} else if (xp->fd == -1)
+			break;
+		else if (!(w & COIO_WRITE))
+			continue;
+
+		n = write(xp->fd, p, l);
+
+		if (n == 0)
+			break;
+		else if (n == -1 && errno == EAGAIN)
+			continue;
+		else if (n == -1)
+			return n;
+
+		xcic_intl_capture(xp, XCIC_CAPTURE_TX, p, n);
+		xp->stats.bytes_out += n;
+
+		l -= n;
+		p += n;
+	}
+
+	return count - l;
+}
+
+int xcic_intl_port_open(lua_State *L, struct xcic_port *xp, const char *pathname)
+{
+	xp->fd = coio_call(xcic_intl_open_cb, pathname, O_RDWR | O_NOCTTY | O_SYNC | O_NONBLOCK);
+	if (xp->fd == -1)
+		xcic_lua_except(L, "open: %s", strerror(errno));
+
+	struct termios tty = {.c_cflag = CS8 | CLOCAL | CREAD | PARENB};
+
+	(void)cfsetospeed(&tty, B38400);
+	(void)cfsetispeed(&tty, B38400);
+
+	if (tcsetattr(xp->fd, TCSANOW, &tty) == -1)
+		xcic_lua_except(L, "tcsetattr: %s", strerror(errno));
+
+	return 0;
+
+except:
+	xcic_intl_port_close(xp);
+
+	return -1; // caller must invoke `lua_error`
+}
+
+void xcic_intl_port_close(struct xcic_port *xp)
+{
+	int fd = xp->fd;
+	xp->fd = -1;
+
+	(void)coio_close(fd);
+}
+
+/*
+ * Buffers a record of the traffic. The capture fiber writes the buffer out
+ * from a coio thread, an exchange only pays for the copy.
+ */
+void xcic_intl_capture(struct xcic_port *xp, enum xcic_capture_kind kind, const void *data,
+		       size_t len)
+{
+	struct xcic_capture *capture = xp->capture;
+
+	if (!capture)
+		return;
+
+	while (len > 0) {
+		uint16_t n = len > UINT16_MAX ? UINT16_MAX : len;
+
+		char *p = (char *)ibuf_alloc(&capture->buf, XCIC_CAPTURE_HEADER_SIZE + n);
+		if (!p) {
+			capture->dropped++;
+			return;
+		}
+
+		p = xcic_capture_encode_header(p, clock_monotonic64(), kind, n);
+		memcpy(p, data, n);
+
+		data = (const char *)data + n;
+		len -= n;
+	}
+
+	if (ibuf_used(&capture->buf) >= XCIC_CAPTURE_FLUSH_SIZE)
+		fiber_cond_signal(capture->cond);
+}
+
+/* rotates the files out of the way and starts a new one, -1 with errno on failure */
+int xcic_intl_capture_open(struct xcic_capture *capture)
+{
+	char from[PATH_MAX], to[PATH_MAX];
+
+	for (int i = capture->files - 1; i > 0; i--) {
+		if (i > 1)
+			snprintf(from, sizeof(from), "%s.%d", capture->pathname, i - 1);
+		else
+			snprintf(from, sizeof(from), "%s", capture->pathname);
+		snprintf(to, sizeof(to), "%s.%d", capture->pathname, i);
+
+		(void)rename(from, to);
+	}
+
+	capture->fd = open(capture->pathname, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (capture->fd == -1)
+		return -1;
+
+	capture->size = 0;
+
+	if (write(capture->fd, XCIC_CAPTURE_MAGIC, XCIC_CAPTURE_MAGIC_SIZE) !=
+	    XCIC_CAPTURE_MAGIC_SIZE) {
+		int err = errno;
+		close(capture->fd);
+		capture->fd = -1;
+		errno = err;
+		return -1;
+	}
+
+	capture->size = XCIC_CAPTURE_MAGIC_SIZE;
+
+	return 0;
+}
+
+/*
+ * Runs in a coio thread: writes `out` to the current file, opening it first
+ * if need be, and rotates the files once it is full. The fields it touches
+ * belong to the thread until coio_call returns. -1 if records were lost.
+ */
+ssize_t xcic_intl_capture_write_cb(va_list ap)
+{
+	struct xcic_capture *capture = va_arg(ap, struct xcic_capture *);
+	struct ibuf *out = &capture->out;
+
+	capture->error = 0;
+
+	if (capture->fd == -1 && xcic_intl_capture_open(capture)) {
+		capture->error = errno;
+		return -1;
+	}
+
+	while (ibuf_used(out) > 0) {
+		ssize_t n = write(capture->fd, out->rpos, ibuf_used(out));
+
+		if (n == -1 && errno == EINTR)
+			continue;
+
+		if (n <= 0) {
+			capture->error = n ? errno : EIO;
+			close(capture->fd);
+			capture->fd = -1;
+			return -1;
+		}
+
+		out->rpos += n;
+		capture->size += n;
+	}
+
+	if (capture->size >= capture->size_max) {
+		close(capture->fd);
+		capture->fd = -1;
+
+		/* retried on the next write, nothing is lost yet */
+		if (xcic_intl_capture_open(capture))
+			capture->error = errno;
+	}
+
+	return 0;
+}
+
+/*
+ * Swaps the buffers and writes the filled one out every flush interval, or
+ * sooner once it holds a flush size, so an idle port does not keep its last
+ * records in memory. Whole records only end up in a file, what fails to be
+ * written is counted and dropped. Frees the capture once stopped.
+ */
+int xcic_intl_capture_f(va_list ap)
+{
+	struct xcic_capture *capture = va_arg(ap, struct xcic_capture *);
+
+	while (!capture->stopping || ibuf_used(&capture->buf) > 0) {
+		if (!capture->stopping && ibuf_used(&capture->buf) < XCIC_CAPTURE_FLUSH_SIZE)
+			fiber_cond_wait_timeout(capture->cond, XCIC_CAPTURE_FLUSH_INTERVAL);
+
+		if (!ibuf_used(&capture->buf))
+			continue;
+
+		struct ibuf buf = capture->out;
+		capture->out = capture->buf;
+		capture->buf = buf;
+
+		if (coio_call(xcic_intl_capture_write_cb, capture))
+			capture->dropped++;
+
+		if (capture->error)
+			say_warn("xcic: capture %s: %s", capture->pathname,
+				 strerror(capture->error));
+
+		ibuf_reset(&capture->out);
+	}
+
+	xcic_intl_capture_free(capture);
+
+	return 0;
+}
+
+void xcic_intl_capture_free(struct xcic_capture *capture)
+{
+	if (!capture)
+		return;
+
+	if (capture->fd != -1)
+		(void)coio_close(capture->fd);
+
+	if (capture->cond)
+		fiber_cond_delete(capture->cond);
+
+	ibuf_destroy(&capture->buf);
+	ibuf_destroy(&capture->out);
+	free(capture->pathname);
+	free(capture);
+}
+
+/* the capture fiber writes out what is left and frees it, the caller does not wait */
+void xcic_intl_capture_delete(struct xcic_capture *capture)
+{
+	if (!capture)
+		return;
+
+	capture->stopping = true;
+	fiber_cond_signal(capture->cond);
+}
+
+struct xcic_ring *xcic_intl_ring_new(size_t size)
+{
+	struct xcic_ring *ring =
+	    (struct xcic_ring *)malloc(sizeof(*ring) + size * sizeof(ring->slots[0]));
+
+	if (ring) {
+		ring->size = size;
+		ring->count = 0;
+	}
+
+	return ring;
+}
+
+/* takes the next slot of the ring for an exchange starting with `request` */
+struct xcic_ring_slot *xcic_intl_ring_record(struct xcic_port *xp, const char *request,
+					     size_t length)
+{
+	struct xcic_ring *ring = xp->ring;
+
+	if (!ring)
+		return NULL;
+
+	struct xcic_ring_slot *slot = &ring->slots[ring->count++ % ring->size];
+
+	slot->ts = clock_realtime();
+	slot->latency = 0;
+	slot->error = SCOM_ERROR_NO_ERROR;
+	slot->request_length = length;
+	slot->response_length = 0;
+	memcpy(slot->request, request, XCIC_MIN(length, sizeof(slot->request)));
+
+	return slot;
+}
+
+/* pushes the fields of a frame as far as the bytes kept go */
+void xcic_intl_ring_frame_push(lua_State *L, const char *frame, size_t wire_length)
+{
+	size_t length = XCIC_MIN(wire_length, (size_t)XCIC_RING_FRAME_SIZE);
+
+	lua_createtable(L, 0, 10);
+
+	lua_pushlstring(L, frame, length);
+	lua_setfield(L, -2, "raw");
+	lua_pushinteger(L, wire_length);
+	lua_setfield(L, -2, "length");
+
+	if (length < SCOM_FRAME_HEADER_SIZE)
+		return;
+
+	lua_pushinteger(L, scom_read_le32(&frame[2]));
+	lua_setfield(L, -2, "src_addr");
+	lua_pushinteger(L, scom_read_le32(&frame[6]));
+	lua_setfield(L, -2, "dst_addr");
+
+	const char *data = &frame[SCOM_FRAME_HEADER_SIZE];
+	size_t data_length =
+	    XCIC_MIN((size_t)scom_read_le16(&frame[10]), length - SCOM_FRAME_HEADER_SIZE);
+
+	if (data_length < 10)
+		return;
+
+	lua_pushinteger(L, (uint8_t)data[0]);
+	lua_setfield(L, -2, "service_flags");
+	lua_pushinteger(L, (uint8_t)data[1]);
+	lua_setfield(L, -2, "service_id");
+	lua_pushinteger(L, scom_read_le16(&data[2]));
+	lua_setfield(L, -2, "object_type");
+	lua_pushinteger(L, scom_read_le32(&data[4]));
+	lua_setfield(L, -2, "object_id");
+	lua_pushinteger(L, scom_read_le16(&data[8]));
+	lua_setfield(L, -2, "property_id");
+	lua_pushlstring(L, &data[10], data_length - 10);
+	lua_setfield(L, -2, "value");
+
+	/* responses flag errors and carry the code in place of the value */
+	if ((data[0] & 0x1) && data_length >= 12) {
+		lua_pushstring(L, xcic_codec_strerror(scom_read_le16(&data[10])));
+		lua_setfield(L, -2, "error");
+	}
+}
+
+/*
+ * Takes the port for exchanges. A busy port is handed over by the holder
+ * to the first waiter of the highest priority, so a write never waits for
+ * more than the exchange in progress. Waiting is not cancellable, like
+ * with box_latch.
+ */
+void xcic_intl_port_lock(struct xcic_port *xp, enum xcic_priority priority)
+{
+	struct xcic_queue_stats *q = &xp->stats.queue[priority];
+
+	q->acquired++;
+
+	if (!xp->busy) {
+		xp->busy = true;
+		xp->holder = priority;
+		return;
+	}
+
+	struct xcic_queue_waiter waiter = {.fiber = fiber_self()};
+	rlist_add_tail(&xp->waiters[priority], &waiter.link);
+
+	if (++q->depth > q->depth_max)
+		q->depth_max = q->depth;
+
+	double started = fiber_clock();
+
+	/* wakeups of other origins do not count */
+	while (!waiter.granted)
+		fiber_yield();
+
+	double wait = fiber_clock() - started;
+
+	q->waits++;
+	q->wait += wait;
+	if (wait > q->wait_max)
+		q->wait_max = wait;
+}
+
+void xcic_intl_port_unlock(struct xcic_port *xp)
+{
+	for (int i = 0; i < XCIC_PRIORITY_MAX; i++) {
+		if (rlist_empty(&xp->waiters[i]))
+			continue;
+
+		struct xcic_queue_waiter *waiter =
+		    rlist_shift_entry(&xp->waiters[i], struct xcic_queue_waiter, link);
+
+		xp->stats.queue[i].depth--;
+		xp->holder = (enum xcic_priority)i;
+		waiter->granted = true;
+		fiber_wakeup(waiter->fiber);
+		return;
+	}
+
+	xp->busy = false;
+}
+
+/*
+ * Reads a property, the prepared `request` if given, unless the same read
+ * is already on the wire: then waits for it and shares its result, whatever
+ * the timeout. A read queued at a lower priority is not joined, it could keep
+ * an interactive caller behind a bulk transfer. On success the value is
+ * copied to `value`, which has room for XCIC_FRAME_DATA_SIZE_MAX bytes, and
+ * `property` points to it.
+ */
+int xcic_intl_read_shared(lua_State *L, struct xcic_port *xp, enum xcic_priority priority,
+			  double timeout, double max_age, const struct xcic_request *request,
+			  scom_property_t *property, char *value)
+{
+	scom_frame_t *frame = property->frame;
+
+	if (request) {
+		frame->dst_addr = request->dst_addr;
+		property->object_type = request->object_type;
+		property->object_id = request->object_id;
+		property->property_id = request->property_id;
+	}
+
+	bool cacheable = xp->cache && (property->object_type == SCOM_PARAMETER_OBJECT_TYPE ||
+				       property->object_type == SCOM_USER_INFO_OBJECT_TYPE);
+
+	if (cacheable && max_age < 0)
+		max_age = property->object_type == SCOM_PARAMETER_OBJECT_TYPE
+			      ? xp->cache->parameter_ttl
+			      : xp->cache->user_info_ttl;
+
+	if (cacheable && max_age > 0) {
+		struct xcic_cache_entry *cached =
+		    xcic_intl_cache_slot(xp->cache, frame->dst_addr, property->object_type,
+					 property->object_id, property->property_id);
+
+		xp->stats.cache_lookups++;
+
+		if (cached->ts > 0 && cached->dst_addr == frame->dst_addr &&
+		    cached->object_type == property->object_type &&
+		    cached->object_id == property->object_id &&
+		    cached->property_id == property->property_id &&
+		    fiber_clock() - cached->ts <= max_age) {
+			xp->stats.cache_hits++;
+			memcpy(value, cached->value, cached->value_length);
+			property->value_buffer = value;
+			property->value_length = cached->value_length;
+			return 0;
+		}
+	}
+
+	struct xcic_flight *flight;
+
+	rlist_foreach_entry(flight, &xp->flights, link) {
+		if (flight->dst_addr != frame->dst_addr ||
+		    flight->object_type != property->object_type ||
+		    flight->object_id != property->object_id ||
+		    flight->property_id != property->property_id ||
+		    flight->priority > priority)
+			continue;
+
+		struct xcic_queue_waiter waiter = {.fiber = fiber_self()};
+		rlist_add_tail(&flight->followers, &waiter.link);
+
+		while (!waiter.granted)
+			fiber_yield();
+
+		xp->stats.coalesced++;
+
+		int ret = 0;
+
+		if (flight->error != SCOM_ERROR_NO_ERROR) {
+			frame->last_error = flight->error;
+			lua_pushstring(L, flight->errmsg);
+			ret = -1;
+		} else {
+			memcpy(value, flight->value, flight->value_length);
+			property->value_buffer = value;
+			property->value_length = flight->value_length;
+		}
+
+		if (--flight->pending == 0)
+			fiber_wakeup(flight->leader);
+
+		return ret; // caller must invoke `lua_error` on failure
+	}
+
+	struct xcic_flight own = {
+	    .dst_addr = frame->dst_addr,
+	    .object_type = property->object_type,
+	    .object_id = property->object_id,
+	    .property_id = property->property_id,
+	    .priority = priority,
+	    .leader = fiber_self(),
+	};
+
+	rlist_create(&own.followers);
+	rlist_add_tail(&xp->flights, &own.link);
+
+	xcic_intl_port_lock(xp, priority);
+	xp->timeout = timeout;
+	int ret = request ? xcic_scom_read_prepared(L, xp, &xp->ibuf, request, property)
+			  : xcic_scom_read_property(L, xp, &xp->ibuf, property, NULL, 0);
+	xcic_intl_port_unlock(xp);
+
+	rlist_del(&own.link);
+
+	if (ret) {
+		own.error = frame->last_error ?: SCOM_ERROR_INVALID_FRAME;
+		snprintf(own.errmsg, sizeof(own.errmsg), "%s", lua_tostring(L, -1) ?: "");
+	} else {
+		memcpy(value, property->value_buffer, property->value_length);
+		property->value_buffer = value;
+		own.value = value;
+		own.value_length = property->value_length;
+
+		/* the cache may have been replaced or dropped meanwhile */
+		if (cacheable && xp->cache && property->value_length <= XCIC_VALUE_SIZE_MAX) {
+			struct xcic_cache_entry *cached =
+			    xcic_intl_cache_slot(xp->cache, own.dst_addr, own.object_type,
+						 own.object_id, own.property_id);
+
+			cached->dst_addr = own.dst_addr;
+			cached->object_type = own.object_type;
+			cached->object_id = own.object_id;
+			cached->property_id = own.property_id;
+			cached->ts = fiber_clock();
+			cached->value_length = property->value_length;
+			memcpy(cached->value, value, property->value_length);
+		}
+	}
+
+	struct xcic_queue_waiter *waiter, *tmp;
+
+	rlist_foreach_entry_safe(waiter, &own.followers, link, tmp) {
+		own.pending++;
+		waiter->granted = true;
+		fiber_wakeup(waiter->fiber);
+	}
+
+	/* the result lives on this stack until the followers are done with it */
+	while (own.pending)
+		fiber_yield();
+
+	return ret; // caller must invoke `lua_error` on failure
+}
+
+/* the slot the tuple maps to, it may hold another one */
+struct xcic_cache_entry *xcic_intl_cache_slot(struct xcic_cache *cache, uint32_t dst_addr,
+					      scom_object_type_t object_type, uint32_t object_id,
+					      uint16_t property_id)
+{
+	uint64_t h = dst_addr;
+
+	h = h * 31 + object_type;
+	h = h * 31 + object_id;
+	h = h * 31 + property_id;
+	h ^= h >> 17;
+
+	return &cache->entries[h % cache->size];
+}
+
+/* drops every property of the object, a write may change more than one */
+void xcic_intl_cache_invalidate(struct xcic_cache *cache, uint32_t dst_addr,
+				scom_object_type_t object_type, uint32_t object_id)
+{
+	for (size_t i = 0; i < cache->size; i++) {
+		struct xcic_cache_entry *e = &cache->entries[i];
+
+		if (e->dst_addr == dst_addr && e->object_type == object_type &&
+		    e->object_id == object_id)
+			e->ts = 0;
+	}
+}
+
+/*
+ * Lets waiters of a higher priority than the holder in, then takes the port
+ * back ahead of its own class: a datalog transfer left open on a device must
+ * not have a second one started in between its blocks. Getting the port back
+ * is not a new acquisition and its wait is not counted.
+ */
+void xcic_intl_port_yield(struct xcic_port *xp)
+{
+	enum xcic_priority priority = xp->holder;
+
+	for (int i = 0; i < (int)priority; i++) {
+		if (rlist_empty(&xp->waiters[i]))
+			continue;
+
+		struct xcic_queue_waiter waiter = {.fiber = fiber_self()};
+		rlist_add(&xp->waiters[priority], &waiter.link);
+		xp->stats.queue[priority].depth++;
+
+		xcic_intl_port_unlock(xp);
+
+		while (!waiter.granted)
+			fiber_yield();
+
+		return;
+	}
+}
+
+void xcic_intl_stats_latency(struct xcic_port *xp, uint32_t dst_addr,
+			     scom_object_type_t object_type, double latency)
+{
+	struct xcic_port_stats *stats = &xp->stats;
+	struct xcic_stats_latency *l = NULL;
+
+	for (size_t i = 0; i < stats->latency_count; i++) {
+		if (stats->latencies[i].dst_addr == dst_addr &&
+		    stats->latencies[i].object_type == object_type) {
+			l = &stats->latencies[i];
+			break;
+		}
+	}
+
+	if (!l) {
+		if (stats->latency_count == XCIC_STATS_LATENCY_MAX) {
+			stats->latency_untracked++;
+			return;
+		}
+
+		l = &stats->latencies[stats->latency_count++];
+		l->dst_addr = dst_addr;
+		l->object_type = object_type;
+	}
+
+	size_t b = 0;
+	while (b < SCOM_NBR_ELEMENTS(xcic_stats_buckets) && latency > xcic_stats_buckets[b])
+		b++;
+
+	l->buckets[b]++;
+	l->count++;
+	l->sum += latency;
+}
+
+void xcic_intl_stats_error(struct xcic_port *xp, scom_error_t code)
+{
+	struct xcic_port_stats *stats = &xp->stats;
+
+	if (code == SCOM_ERROR_NO_ERROR)
+		return;
+
+	for (size_t i = 0; i < stats->error_count; i++) {
+		if (stats->errors[i].code == code) {
+			stats->errors[i].count++;
+			return;
+		}
+	}
+
+	/* codes are a closed set, the table does not fill up in practice */
+	if (stats->error_count == XCIC_STATS_ERRORS_MAX)
+		return;
+
+	stats->errors[stats->error_count].code = code;
+	stats->errors[stats->error_count].count = 1;
+	stats->error_count++;
+}
+
+/*
+ * Appends the counters of all the registered ports to a Prometheus
+ * exposition, each family with all its ports in a row.
+ */
+int xcic_intl_stats_render(struct ibuf *buf)
+{
+	static const struct {
+		const char *name;
+		size_t offset;
+	} counters[] = {
+	    {"xci_port_requests", offsetof(struct xcic_port_stats, requests)},
+	    {"xci_port_coalesced_reads", offsetof(struct xcic_port_stats, coalesced)},
+	    {"xci_port_cache_lookups", offsetof(struct xcic_port_stats, cache_lookups)},
+	    {"xci_port_cache_hits", offsetof(struct xcic_port_stats, cache_hits)},
+	    {"xci_port_bytes_out", offsetof(struct xcic_port_stats, bytes_out)},
+	    {"xci_port_bytes_in", offsetof(struct xcic_port_stats, bytes_in)},
+	    {"xci_port_checksum_errors", offsetof(struct xcic_port_stats, checksum_errors)},
+	    {"xci_port_reopens", offsetof(struct xcic_port_stats, reopens)},
+	};
+
+	struct xcic_port *xp;
+	char *p;
+
+	for (size_t m = 0; m < SCOM_NBR_ELEMENTS(counters); m++) {
+		bool type_done = false;
+
+		rlist_foreach_entry(xp, &xcic_port_registry, link) {
+			p = (char *)ibuf_reserve(buf, strlen(xp->name) + 128);
+			if (!p)
+				return -1;
+
+			if (!type_done) {
+				p += sprintf(p, "# TYPE %s counter\n", counters[m].name);
+				type_done = true;
+			}
+
+			uint64_t value = *(const uint64_t *)((const char *)&xp->stats +
+							     counters[m].offset);
+			p += sprintf(p, "%s{port=\"%s\"} %" PRIu64 "\n", counters[m].name,
+				     xp->name, value);
+
+			buf->wpos = p;
+		}
+	}
+
+	static const char *const queue_metrics[][2] = {
+	    {"xci_port_queue_depth", "gauge"},
+	    {"xci_port_queue_waits", "counter"},
+	    {"xci_port_queue_wait_seconds", "counter"},
+	};
+
+	for (size_t m = 0; m < SCOM_NBR_ELEMENTS(queue_metrics); m++) {
+		p = (char *)ibuf_reserve(buf, 64);
+		if (!p)
+			return -1;
+
+		p += sprintf(p, "# TYPE %s %s\n", queue_metrics[m][0], queue_metrics[m][1]);
+		buf->wpos = p;
+
+		rlist_foreach_entry(xp, &xcic_port_registry, link) {
+			for (int i = 0; i < XCIC_PRIORITY_MAX; i++) {
+				const struct xcic_queue_stats *q = &xp->stats.queue[i];
+
+				p = (char *)ibuf_reserve(buf, strlen(xp->name) + 128);
+				if (!p)
+					return -1;
+
+				p += sprintf(p, "%s{port=\"%s\",class=\"%s\"} ",
+					     queue_metrics[m][0], xp->name, xcic_priority_names[i]);
+
+				if (m == 0)
+					p += sprintf(p, "%" PRIu64 "\n", q->depth);
+				else if (m == 1)
+					p += sprintf(p, "%" PRIu64 "\n", q->waits);
+				else
+					p += sprintf(p, "%.6f\n", q->wait);
+
+				buf->wpos = p;
+			}
+		}
+	}
+
+	bool type_done = false;
+
+	rlist_foreach_entry(xp, &xcic_port_registry, link) {
+		for (size_t i = 0; i < xp->stats.error_count; i++) {
+			const struct xcic_stats_error *e = &xp->stats.errors[i];
+
+			p = (char *)ibuf_reserve(buf, strlen(xp->name) + 160);
+			if (!p)
+				return -1;
+
+			if (!type_done) {
+				p += sprintf(p, "# TYPE xci_port_errors counter\n");
+				type_done = true;
+			}
+
+			p += sprintf(p, "xci_port_errors{port=\"%s\",error=\"%s\"} %" PRIu64 "\n",
+				     xp->name, xcic_codec_strerror(e->code), e->count);
+
+			buf->wpos = p;
+		}
+	}
+
+	type_done = false;
+
+	rlist_foreach_entry(xp, &xcic_port_registry, link) {
+		for (size_t i = 0; i < xp->stats.latency_count; i++) {
+			const struct xcic_stats_latency *l = &xp->stats.latencies[i];
+
+			p = (char *)ibuf_reserve(buf, (XCIC_STATS_BUCKET_COUNT + 2) *
+							  (strlen(xp->name) + 128) +
+						      64);
+			if (!p)
+				return -1;
+
+			if (!type_done) {
+				p += sprintf(p, "# TYPE xci_request_duration_seconds histogram\n");
+				type_done = true;
+			}
+
+			char labels[160], le[16];
+			snprintf(labels, sizeof(labels),
+				 "port=\"%s\",dst=\"%u\",object_type=\"%u\"", xp->name,
+				 l->dst_addr, l->object_type);
+
+			uint64_t cumulative = 0;
+
+			for (size_t b = 0; b < XCIC_STATS_BUCKET_COUNT; b++) {
+				cumulative += l->buckets[b];
+
+				if (b < SCOM_NBR_ELEMENTS(xcic_stats_buckets))
+					snprintf(le, sizeof(le), "%g", xcic_stats_buckets[b]);
+				else
+					snprintf(le, sizeof(le), "+Inf");
+
+				p += sprintf(p,
+					     "xci_request_duration_seconds_bucket"
+					     "{%s,le=\"%s\"} %" PRIu64 "\n",
+					     labels, le, cumulative);
+			}
+
+			p += sprintf(p, "xci_request_duration_seconds_sum{%s} %.6f\n", labels,
+				     l->sum);
+			p += sprintf(p, "xci_request_duration_seconds_count{%s} %" PRIu64 "\n",
+				     labels, l->count);
+
+			buf->wpos = p;
+		}
+	}
+
+	return 0;
+}
+
+struct xcic_port *xcic_intl_port_find(const char *name)
+{
+	struct xcic_port *xp;
+
+	rlist_foreach_entry(xp, &xcic_port_registry, link) {
+		if (!strcmp(xp->name, name))
+			return xp;
+	}
+
+	return NULL;
+}
+
+void xcic_intl_port_unregister(lua_State *L, struct xcic_port *xp)
+{
+	if (!xp->name)
+		return;
+
+	rlist_del(&xp->link);
+
+	free(xp->name);
+	xp->name = NULL;
+
+	luaL_unref(L, LUA_REGISTRYINDEX, xp->self_ref);
+	xp->self_ref = LUA_NOREF;
+}
+
+/*
+ * Replaces rather than inserts, so that loading a file again, e.g. today's
+ * file that keeps growing, only adds the new rows.
+ */
+int xcic_intl_datalog_store(uint32_t space_id, const struct xcic_datalog *log, char *errmsg,
+			    size_t errmsg_size)
+{
+	const char *p = log->tuples;
+	const char *end = log->tuples + log->tuples_size;
+
+	while (p < end) {
+		if (box_txn_begin())
+			goto except;
+
+		for (size_t i = 0; i < XCIC_DATALOG_BATCH && p < end; i++) {
+			const char *tuple = p;
+			mp_next(&p);
+
+			if (box_replace(space_id, tuple, p, NULL)) {
+				(void)box_txn_rollback();
+				goto except;
+			}
+		}
+
+		if (box_txn_commit())
+			goto except;
+	}
+
+	return 0;
+
+except:
+	snprintf(errmsg, errmsg_size, "%s", box_error_message(box_error_last()));
+
+	return -1;
+}
+
+ssize_t xcic_intl_datalog_parse_cb(va_list ap)
+{
+	struct xcic_datalog *log = va_arg(ap, struct xcic_datalog *);
+	const char *data = va_arg(ap, const char *);
+	size_t size = va_arg(ap, size_t);
+
+	return xcic_datalog_parse(log, data, size);
+}
+
+ssize_t xcic_intl_datalog_parse_file_cb(va_list ap)
+{
+	struct xcic_datalog *log = va_arg(ap, struct xcic_datalog *);
+	const char *path = va_arg(ap, const char *);
+
+	return xcic_datalog_parse_file(log, path);
+}
+
+static int xcic_intl_name_cmp(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* the sorted names of the *.csv files of a directory */
+ssize_t xcic_intl_datalog_list_cb(va_list ap)
+{
+	const char *dirname = va_arg(ap, const char *);
+	char ***names = va_arg(ap, char ***);
+	size_t *count = va_arg(ap, size_t *);
+
+	DIR *dir = opendir(dirname);
+	if (!dir)
+		return -1;
+
+	size_t capacity = 0;
+	struct dirent *de;
+
+	while ((de = readdir(dir))) {
+		size_t len = strlen(de->d_name);
+		if (len < 4 || strcasecmp(de->d_name + len - 4, ".csv"))
+			continue;
+
+		if (*count == capacity) {
+			capacity = capacity ? capacity * 2 : 64;
+			char **tmp = (char **)realloc(*names, capacity * sizeof(*tmp));
+			if (!tmp)
+				break;
+			*names = tmp;
+		}
+
+		(*names)[*count] = strdup(de->d_name);
+		if (!(*names)[*count])
+			break;
+		(*count)++;
+	}
+
+	closedir(dir);
+
+	if (*count)
+		qsort(*names, *count, sizeof(**names), xcic_intl_name_cmp);
+
+	return 0;
+}
+
+int xcic_intl_datalog_worker_f(va_list ap)
+{
+	struct xcic_datalog_job *job = va_arg(ap, struct xcic_datalog_job *);
+
+	while (job->next < job->count && !fiber_is_cancelled()) {
+		size_t i = job->next++;
+
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s/%s", job->dirname, job->names[i]);
+
+		struct xcic_datalog log;
+		memset(&log, 0, sizeof(log));
+
+		job->stored[i] = -1;
+
+		if (coio_call(xcic_intl_datalog_parse_file_cb, &log, path))
+			snprintf(job->errmsgs[i], sizeof(job->errmsgs[i]), "%s",
+				 log.errmsg[0] ? log.errmsg : "parse failed");
+		else if (!xcic_intl_datalog_store(job->space_id, &log, job->errmsgs[i],
+						  sizeof(job->errmsgs[i])))
+			job->stored[i] = log.tuple_count;
+
+		xcic_datalog_destroy(&log);
+	}
+
+	return 0;
+}
+
+int xcic_intl_xfer_sink_put(lua_State *L, struct xcic_xfer_sink *sink, const char *data,
+			    size_t data_len)
+{
+	/* resuming: drop what the sink got from an earlier transfer */
+	if (sink->length < sink->offset) {
+		size_t held = sink->offset - sink->length;
+		if (held > data_len)
+			held = data_len;
+
+		sink->length += held;
+		data += held;
+		data_len -= held;
+
+		if (!data_len)
+			return 0;
+	}
+
+	if (sink->ibuf) {
+		void *ptr = ibuf_alloc(sink->ibuf, data_len);
+		if (!ptr)
+			xcic_lua_except(L, "alloc failed");
+
+		memcpy(ptr, data, data_len);
+	} else if (sink->fd != -1) {
+		for (size_t l = data_len; l > 0;) {
+			ssize_t n = write(sink->fd, data + data_len - l, l);
+
+			if (n == -1 && errno == EAGAIN)
+				(void)coio_wait(sink->fd, COIO_WRITE, TIMEOUT_INFINITY);
+			else if (n == -1)
+				xcic_lua_except(L, "write: %s", strerror(errno));
+			else
+				l -= n;
+		}
+	} else {
+		lua_pushvalue(L, sink->callback);
+		lua_pushlstring(L, data, data_len);
+		if (lua_pcall(L, 1, 0, 0))
+			goto except; // error saved
+	}
+
+	sink->length += data_len;
+
+	return 0;
+
+except:
+	return -1; // caller must invoke `lua_error`
+}
+
+int xcic_intl_message_read(lua_State *L, struct xcic_port *xp, uint32_t dst_addr, uint32_t index,
+			   struct xcic_message *message)
+{
+	scom_frame_t frame;
+	scom_initialize_frame(&frame, NULL, 0);
+
+	frame.src_addr = 1;
+	frame.dst_addr = dst_addr;
+
+	scom_property_t property;
+	scom_initialize_property(&property, &frame);
+
+	property.object_type = 3; // message
+	property.object_id = index;
+	property.property_id = 0;
+
+	if (xcic_scom_read_property(L, xp, &xp->ibuf, &property, NULL, 0))
+		goto except;
+
+	if (property.value_length != 4 + 2 + 4 + 4 + 4)
+		xcic_lua_except(L, "invalid message data length %d", property.value_length);
+
+	message->count = scom_read_le32(&property.value_buffer[0]);
+	message->type = scom_read_le16(&property.value_buffer[4]);
+	message->src_addr = scom_read_le32(&property.value_buffer[6]);
+	message->ts = scom_read_le32(&property.value_buffer[10]);
+	message->value = scom_read_le32(&property.value_buffer[14]);
+
+	return 0;
+
+except:
+	return -1; // caller must invoke `lua_error`
+}
+
+struct xcic_message_cursor *xcic_intl_message_cursor(struct xcic_port *xp, uint32_t dst_addr)
+{
+	for (size_t i = 0; i < XCIC_MESSAGE_SOURCES_MAX; i++) {
+		struct xcic_message_cursor *cursor = &xp->cursors[i];
+
+		if (cursor->dst_addr == dst_addr)
+			return cursor;
+
+		if (!cursor->dst_addr) {
+			cursor->dst_addr = dst_addr;
+			return cursor;
+		}
+	}
+
+	return NULL;
+}
+
+/* tuples [ts, src_addr, type, value] of the xci_message space */
+int xcic_intl_messages_store(uint32_t space_id, const struct xcic_message *messages, size_t count,
+			     char *errmsg, size_t errmsg_size)
+{
+	if (!count)
+		return 0;
+
+	if (box_txn_begin())
+		goto except;
+
+	for (size_t i = 0; i < count; i++) {
+		char tuple[1 + 4 * 5];
+		char *p = tuple;
+
+		p = mp_encode_array(p, 4);
+		p = mp_encode_uint(p, messages[i].ts);
+		p = mp_encode_uint(p, messages[i].src_addr);
+		p = mp_encode_uint(p, messages[i].type);
+		p = mp_encode_uint(p, messages[i].value);
+
+		if (box_replace(space_id, tuple, p, NULL)) {
+			(void)box_txn_rollback();
+			goto except;
+		}
+	}
+
+	if (box_txn_commit())
+		goto except;
+
+	return 0;
+
+except:
+	snprintf(errmsg, errmsg_size, "%s", box_error_message(box_error_last()));
+
+	return -1;
+}
+
+ssize_t xcic_intl_open_cb(va_list ap)
+{
+	char *pathname = va_arg(ap, char *);
+	int flags = va_arg(ap, int);
+
+	return open(pathname, flags);
+}
+
+/*
+ * Catalog of known objects, sorted by object type and object id.
+ */
+static const struct xcic_object xcic_objects[] = {
+    {SCOM_USER_INFO_OBJECT_TYPE, 3000, SCOM_FORMAT_FLOAT, "xt_ubat_now"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3001, SCOM_FORMAT_FLOAT, "xt_tbat"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3005, SCOM_FORMAT_FLOAT, "xt_ibat_now"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3010, SCOM_FORMAT_ENUM, "xt_phase"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3020, SCOM_FORMAT_ENUM, "xt_transfert"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3028, SCOM_FORMAT_ENUM, "xt_mode"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3030, SCOM_FORMAT_ENUM, "xt_rel_out"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3031, SCOM_FORMAT_ENUM, "xt_aux1"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3032, SCOM_FORMAT_ENUM, "xt_aux2"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3049, SCOM_FORMAT_ENUM, "xt_state"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3054, SCOM_FORMAT_ENUM, "xt_aux1_mode"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3055, SCOM_FORMAT_ENUM, "xt_aux2_mode"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3074, SCOM_FORMAT_ENUM, "xt_rel_gnd"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3075, SCOM_FORMAT_ENUM, "xt_rel_neutral"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3086, SCOM_FORMAT_ENUM, "xt_rme"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3090, SCOM_FORMAT_FLOAT, "xt_ubat_min"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3092, SCOM_FORMAT_FLOAT, "xt_ubat"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3095, SCOM_FORMAT_FLOAT, "xt_ibat"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3097, SCOM_FORMAT_FLOAT, "xt_pout_plus"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3098, SCOM_FORMAT_FLOAT, "xt_pout"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3101, SCOM_FORMAT_FLOAT, "xt_pout_a"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3103, SCOM_FORMAT_FLOAT, "xt_dev1_plus"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3110, SCOM_FORMAT_FLOAT, "xt_fout"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3113, SCOM_FORMAT_FLOAT, "xt_uin"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3116, SCOM_FORMAT_FLOAT, "xt_iin"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3119, SCOM_FORMAT_FLOAT, "xt_pin_a"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3122, SCOM_FORMAT_FLOAT, "xt_fin"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3130, SCOM_FORMAT_FLOAT, "xt_version_msb"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 3131, SCOM_FORMAT_FLOAT, "xt_version_lsb"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 7000, SCOM_FORMAT_FLOAT, "bsp_ubat_now"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 7001, SCOM_FORMAT_FLOAT, "bsp_ibat_now"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 7002, SCOM_FORMAT_FLOAT, "bsp_soc_now"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 7003, SCOM_FORMAT_FLOAT, "bsp_pbat_now"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 7030, SCOM_FORMAT_FLOAT, "bsp_ubat"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 7031, SCOM_FORMAT_FLOAT, "bsp_ibat"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 7032, SCOM_FORMAT_FLOAT, "bsp_soc"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 7033, SCOM_FORMAT_FLOAT, "bsp_tbat"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 7037, SCOM_FORMAT_FLOAT, "bsp_version_msb"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 7038, SCOM_FORMAT_FLOAT, "bsp_version_lsb"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11000, SCOM_FORMAT_FLOAT, "vt_ubat_now"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11001, SCOM_FORMAT_FLOAT, "vt_ibat_now"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11002, SCOM_FORMAT_FLOAT, "vt_upv_now"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11004, SCOM_FORMAT_FLOAT, "vt_psol_now"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11016, SCOM_FORMAT_ENUM, "vt_mode"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11038, SCOM_FORMAT_ENUM, "vt_phas"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11039, SCOM_FORMAT_FLOAT, "vt_ubam"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11040, SCOM_FORMAT_FLOAT, "vt_ibam"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11041, SCOM_FORMAT_FLOAT, "vt_upvm"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11043, SCOM_FORMAT_FLOAT, "vt_psom"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11045, SCOM_FORMAT_FLOAT, "vt_dev1"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11050, SCOM_FORMAT_FLOAT, "vt_version_msb"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11051, SCOM_FORMAT_FLOAT, "vt_version_lsb"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11061, SCOM_FORMAT_ENUM, "vt_aux1"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11062, SCOM_FORMAT_ENUM, "vt_aux2"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11063, SCOM_FORMAT_ENUM, "vt_aux1_mode"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11064, SCOM_FORMAT_ENUM, "vt_aux2_mode"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11069, SCOM_FORMAT_ENUM, "vt_state"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11077, SCOM_FORMAT_ENUM, "vt_aux3"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11078, SCOM_FORMAT_ENUM, "vt_aux4"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11080, SCOM_FORMAT_ENUM, "vt_aux4_mode"},
+    {SCOM_USER_INFO_OBJECT_TYPE, 11082, SCOM_FORMAT_ENUM, "vt_rme"},
+    {SCOM_PARAMETER_OBJECT_TYPE, 1107, SCOM_FORMAT_FLOAT, "xt_ac_in_max_current"},
+    {SCOM_PARAMETER_OBJECT_TYPE, 1128, SCOM_FORMAT_BOOL, "xt_transfer_allowed"},
+    {SCOM_PARAMETER_OBJECT_TYPE, 1198, SCOM_FORMAT_FLOAT, "xt_transfer_voltage_open_delay"},
+    {SCOM_PARAMETER_OBJECT_TYPE, 1199, SCOM_FORMAT_FLOAT, "xt_transfer_under_voltage"},
+    {SCOM_PARAMETER_OBJECT_TYPE, 1200, SCOM_FORMAT_FLOAT, "xt_transfer_under_voltage_immediate"},
+    {SCOM_PARAMETER_OBJECT_TYPE, 1309, SCOM_FORMAT_FLOAT, "xt_ac_in_low_voltage"},
+    {SCOM_PARAMETER_OBJECT_TYPE, 1432, SCOM_FORMAT_FLOAT, "xt_ac_in_absolute_max_voltage"},
+    {SCOM_PARAMETER_OBJECT_TYPE, 1505, SCOM_FORMAT_FLOAT, "xt_ac_in_over_frequency"},
+    {SCOM_PARAMETER_OBJECT_TYPE, 1506, SCOM_FORMAT_FLOAT, "xt_ac_in_under_frequency"},
+    {SCOM_PARAMETER_OBJECT_TYPE, 1507, SCOM_FORMAT_FLOAT, "xt_transfer_frequency_open_delay"},
+    {SCOM_PARAMETER_OBJECT_TYPE, 1580, SCOM_FORMAT_FLOAT, "xt_transfer_close_delay"},
+    {SCOM_PARAMETER_OBJECT_TYPE, 5002, SCOM_FORMAT_INT32, "rcc_date"},
+    {SCOM_PARAMETER_OBJECT_TYPE, 5061, SCOM_FORMAT_INT32, "rcc_datalog_save"},
+};
+
+/*
+ * Texts of the message types, as the RCC shows them. `{1107}` stands for the
+ * value of that parameter.
+ */
+static const char *const xcic_message_texts[] = {
+    [0] = "Warning (000): Battery low",
+    [1] = "Warning (001): Battery too high",
+    [2] = "Warning (002): Bulk charge too long",
+    [3] = "(003): AC-In synchronization in progress",
+    [4] = "Warning (004): Input frequency AC-In wrong",
+    [5] = "Warning (005): Input frequency AC-In wrong",
+    [6] = "Warning (006): Input voltage AC-In too high",
+    [7] = "Warning (007): Input voltage AC-In too low",
+    [8] = "Halted (008): Inverter overload SC",
+    [9] = "Halted (009): Charger short circuit",
+    [10] = "(010): System start-up in progress",
+    [11] = "Warning (011): AC-In Energy quota",
+    [12] = "(012): Use of battery temperature sensor",
+    [13] = "(013): Use of additional remote control",
+    [14] = "Halted (014): Over temperature EL",
+    [15] = "Halted (015): Inverter overload BL",
+    [16] = "Warning (016): Fan error detected",
+    [17] = "(017): Programing mode",
+    [18] = "Warning (018): Excessive battery voltage ripple",
+    [19] = "Halted (019): Battery undervoltage",
+    [20] = "Halted (020): Battery overvoltage",
+    [21] = "(021): Transfer not authorized, AC-Out current is higher than {1107}",
+    [22] = "Halted (022): Voltage presence on AC-Out",
+    [23] = "Halted (023): Phase not defined",
+    [24] = "Warning (024): Change the clock battery",
+    [25] = "Halted (025): Unknown Command board. Software upgrade needed",
+    [26] = "Halted (026): Unknown Power board. Software upgrade needed",
+    [27] = "Halted (027): Unknown extension board. Software upgrade needed",
+    [28] = "Halted (028): Voltage incompatibility Power - Command",
+    [29] = "Halted (029): Voltage incompatibility Ext. - Command",
+    [30] = "Halted (030): Power incompatibility Power - Command",
+    [31] = "Halted (031): Command board software incompatibility",
+    [32] = "Halted (032): Power board software incompatibility",
+    [33] = "Halted (033): Extension board software incompatibility",
+    [34] = "Halted (034): FID corruption, call factory",
+    [35] = "(035): Memory structure modified",
+    [36] = "Halted (036): Parameter file lacking",
+    [37] = "Warning (037): Message file lack. SW upgrade advised",
+    [38] = "Warning (038): Upgrade of the device software advised",
+    [39] = "Warning (039): Upgrade of the device software advised",
+    [40] = "Warning (040): Upgrade of the device software advised",
+    [41] = "Warning (041): Over temperature TR",
+    [42] = "Halted (042): Unauthorized energy source at the output",
+    [43] = "(043): Start of monthly test",
+    [44] = "(044): End of successfully monthly test",
+    [45] = "Warning (045): Monthly autonomy test failed",
+    [46] = "(046): Start of weekly test",
+    [47] = "(047): End of successfully weekly test",
+    [48] = "Warning (048): Weekly autonomy test failed",
+    [49] = "(049): Transfer opened because AC-In max current exceeded {1107}",
+    [50] = "Error (050): Incomplete data transfer",
+    [51] = "(051): The update is finished",
+    [52] = "(052): Your installation is already updated",
+    [53] = "Halted (053): Devices not compatible, software update required",
+    [54] = "(054): Please wait. Data transfer in progress",
+    [55] = "Error (055): No SD card inserted",
+    [56] = "Warning (056): Upgrade of the RCC software advised",
+    [57] = "(057): Operation finished successfully",
+    [58] = "Halted (058): Master synchronization missing",
+    [59] = "Halted (059): Inverter overload HW",
+    [60] = "Warning (060): Time security 1512 AUX1",
+    [61] = "Warning (061): Time security 1513 AUX2",
+    [62] = "Warning (062): Genset, no AC-In coming after AUX command",
+    [63] = "(063): Save parameter XT",
+    [64] = "(064): Save parameter BSP",
+    [65] = "(065): Save parameter VarioTrack",
+    [71] = "Error (071): Insufficient disk space on SD card",
+    [72] = "Halted (072): COM identification incorrect",
+    [73] = "(073): Datalogger is enabled on this RCC",
+    [74] = "(074): Save parameter Xcom-MS",
+    [75] = "(075): MPPT MS address changed successfully",
+    [76] = "Error (076): Error during change of MPPT MS address",
+    [77] = "Error (077): Wrong MPPT MS DIP Switch position",
+    [78] = "(078): SMS or email sent",
+    [79] = "Halted (079): More than 9 XTs in the system",
+    [80] = "Halted (080): No battery (or reverse polarity)",
+    [81] = "Warning (081): Earthing fault",
+    [82] = "Halted (082): PV overvoltage",
+    [83] = "Warning (083): No solar production in the last 48h",
+    [84] = "(084): Equalization performed",
+    [85] = "Error (085): Modem not available",
+    [86] = "Error (086): Incorrect PIN code, unable to initiate the modem",
+    [87] = "Error (087): Insufficient Signal from GSM modem",
+    [88] = "Error (088): No connection to GSM network",
+    [89] = "Error (089): No Xcom server access",
+    [90] = "(090): Xcom server connected",
+    [91] = "Warning (091): Update finished. Update software of other RCC/Xcom-232i",
+    [92] = "Error (092): More than 4 RCC or Xcom in the system",
+    [93] = "Error (093): More than 1 BSP in the system",
+    [94] = "Error (094): More than 1 Xcom-MS in the system",
+    [95] = "Error (095): More than 15 VarioTrack in the system",
+    [121] = "Error (121): Impossible communication with target device",
+    [122] = "Error (122): SD card corrupted",
+    [123] = "Error (123): SD card not formatted",
+    [124] = "Error (124): SD card not compatible",
+    [125] = "Error (125): SD card format not recognized. Should be FAT",
+    [126] = "Error (126): SD card write protected",
+    [127] = "Error (127): SD card, file(s) corrupted",
+    [128] = "Error (128): SD card file or directory could not be found",
+    [129] = "Error (129): SD card has been prematurely removed",
+    [130] = "Error (130): Update directory is empty",
+    [131] = "(131): The VarioTrack is configured for 12V batteries",
+    [132] = "(132): The VarioTrack is configured for 24V batteries",
+    [133] = "(133): The VarioTrack is configured for 48V batteries",
+    [134] = "(134): Reception level of the GSM signal",
+    [137] = "(137): VarioTrack master synchronization lost",
+    [138] = "Error (138): XT master synchronization lost",
+    [139] = "(139): Synchronized on VarioTrack master",
+    [140] = "(140): Synchronized on XT master",
+    [141] = "Error (141): More than 1 Xcom-SMS in the system",
+    [142] = "Error (142): More than 15 VarioString in the system",
+    [143] = "(143): Save parameter Xcom-SMS",
+    [144] = "(144): Save parameter VarioString",
+    [145] = "Error (145): SIM card blocked, PUK code required",
+    [146] = "Error (146): SIM card missing",
+    [147] = "Error (147): Install R532 firmware release prior to install an older release",
+    [148] = "(148): Datalogger function interrupted (SD card removed)",
+    [149] = "Error (149): Parameter setting incomplete",
+    [150] = "Error (150): Cabling error between PV and VarioString",
+    [162] = "Error (162): Communication loss with RCC or Xcom-232i",
+    [163] = "Error (163): Communication loss with Xtender",
+    [164] = "Error (164): Communication loss with BSP",
+    [165] = "Error (165): Communication loss with Xcom-MS",
+    [166] = "Error (166): Communication loss with VarioTrack",
+    [167] = "Error (167): Communication loss with VarioString",
+    [168] = "(168): Synchronized with VarioString master",
+    [169] = "(169): Synchronization with VarioString master lost",
+    [170] = "Warning (170): No solar production in the last 48h on PV1",
+    [171] = "Warning (171): No solar production in the last 48h on PV2",
+    [172] = "Error (172): FID change impossible. More than one unit.",
+    [173] = "Error (173): Incompatible Xtender. Please contact Studer Innotec SA",
+    [174] = "(174): Inaccessible parameter, managed by the Xcom-CAN",
+    [175] = "Halted (175): Critical undervoltage",
+    [176] = "(176): Calibration setting lost",
+    [177] = "(177): An Xtender has started up",
+    [178] = "(178): No BSP. Necessary for programming with SOC",
+    [179] = "(179): No BTS or BSP. Necessary for programming with temperature",
+    [180] = "(180): Command entry activated",
+    [181] = "Error (181): Disconnection of BTS",
+    [182] = "(182): BTS/BSP battery temperature measurement used by a device",
+    [183] = "Halted (183): An Xtender has lost communication with the system",
+    [184] = "Error (184): Check phase orientation or circuit breakers state on AC-In",
+    [185] = "Warning (185): AC-In voltage level with delay too low",
+    [186] = "Halted (186): Critical undervoltage (fast)",
+    [187] = "Halted (187): Critical overvoltage (fast)",
+    [188] = "(188): CAN stage startup",
+    [189] = "Error (189): Incompatible configuration file",
+    [190] = "(190): The Xcom-SMS is busy",
+    [191] = "(191): Parameter not supported",
+    [192] = "(192): Unknown reference",
+    [193] = "(193): Invalid value",
+    [194] = "(194): Value too low",
+    [195] = "(195): Value too high",
+    [196] = "(196): Writing error",
+    [197] = "(197): Reading error",
+    [198] = "(198): User level insufficient",
+    [199] = "(199): No data for the report",
+    [200] = "Error (200): Memory full",
+    [202] = "Warning (202): Battery alarm arrives",
+    [203] = "(203): Battery alarm leaves",
+    [204] = "Error (204): Battery stop arrives",
+    [205] = "(205): Battery stop leaves",
+    [206] = "Halted (206): Board hardware incompatibility",
+    [207] = "(207): AUX1 relay activation",
+    [208] = "(208): AUX1 relay deactivation",
+    [209] = "(209): AUX2 relay activation",
+    [210] = "(210): AUX2 relay deactivation",
+    [211] = "(211): Command entry deactivated",
+    [212] = "Error (212): VarioTrack software incompatibility. Upgrade needed",
+    [213] = "(213): Battery current limitation by the BSP stopped",
+    [214] = "Warning (214): Half period RMS voltage limit exceeded, transfer opened",
+    [215] = "Warning (215): UPS limit reached, transfer opened",
+    [216] = "Warning (216): Scom watchdog caused the reset of Xcom-232i",
+    [217] = "Warning (217): CAN problem at Xtender declaration",
+    [218] = "Warning (218): CAN problem while writing parameters",
+    [222] = "(222): Front ON/OFF button pressed",
+    [223] = "(223): Main OFF detected",
+    [224] = "(224): Delay before closing transfer relay in progress {1580}",
+    [225] = "Error (225): Communication with lithium battery lost",
+    [226] = "(226): Communication with lithium battery restored",
+    [227] = "Error (227): Overload on high voltage DC side",
+    [228] = "Error (228): Startup error",
+    [229] = "Error (229): Short-circuit on high voltage DC side",
+};
+
+const char *xcic_intl_message_text(uint16_t type)
+{
+	return type < SCOM_NBR_ELEMENTS(xcic_message_texts) ? xcic_message_texts[type] : NULL;
+}
+
+static int xcic_intl_object_cmp(const void *a, const void *b)
+{
+	const struct xcic_object *l = (const struct xcic_object *)a;
+	const struct xcic_object *r = (const struct xcic_object *)b;
+
+	if (l->object_type != r->object_type)
+		return l->object_type < r->object_type ? -1 : 1;
+	if (l->object_id != r->object_id)
+		return l->object_id < r->object_id ? -1 : 1;
+
+	return 0;
+}
+
+/*
+ * Reads a 4 byte user info with a short timeout, retrying a busy gateway a
+ * few times and a timeout once; returns the error of the last attempt and
+ * leaves the stack as it was.
+ */
+scom_error_t xcic_intl_probe(lua_State *L, struct xcic_port *xp, uint32_t dst_addr,
+			     uint32_t object_id, double timeout, char *value)
+{
+	scom_error_t error;
+	int timeouts = 0;
+
+	for (int attempt = 0;; attempt++) {
+		scom_frame_t frame;
+		scom_initialize_frame(&frame, NULL, 0);
+
+		frame.src_addr = 1;
+		frame.dst_addr = dst_addr;
+
+		scom_property_t property;
+		scom_initialize_property(&property, &frame);
+
+		property.object_type = SCOM_USER_INFO_OBJECT_TYPE;
+		property.object_id = object_id;
+		property.property_id = 1;
+
+		xcic_intl_port_lock(xp, XCIC_PRIORITY_INTERACTIVE);
+		xp->timeout = timeout;
+		int ret = xcic_scom_read_property(L, xp, &xp->ibuf, &property, NULL, 0);
+		xcic_intl_port_unlock(xp);
+
+		if (!ret) {
+			if (property.value_length != 4)
+				return SCOM_ERROR_INVALID_DATA_LENGTH;
+
+			memcpy(value, property.value_buffer, 4);
+			return SCOM_ERROR_NO_ERROR;
+		}
+
+		lua_pop(L, 1); // drop the error
+		error = frame.last_error ?: SCOM_ERROR_INVALID_FRAME;
+
+		if (error == SCOM_ERROR_RESPONSE_TIMEOUT && !timeouts++)
+			continue;
+
+		if (error != SCOM_ERROR_GATEWAY_BUSY || attempt >= XCIC_PROBE_RETRIES)
+			return error;
+
+		fiber_sleep(0.05);
+	}
+}
+
+/* the unit replied, if only to refuse the service or the object */
+bool xcic_intl_probe_answered(scom_error_t error)
+{
+	return error == SCOM_ERROR_NO_ERROR ||
+	       (error >= SCOM_ERROR_SERVICE_NOT_SUPPORTED &&
+		error <= SCOM_ERROR_MULTICAST_READ_NOT_SUPPORTED &&
+		error != SCOM_ERROR_GATEWAY_BUSY);
+}
+
+int xcic_intl_device_class_find(const char *name)
+{
+	for (int i = 0; i < XCIC_DEVICE_CLASS_COUNT; i++) {
+		if (!strcmp(xcic_device_classes[i].name, name))
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+ * Pushes the set of the catalog objects of the class the unit answers; an
+ * object left unanswered is taken as missing. Returns the port or stack
+ * error that stopped it, if any.
+ */
+scom_error_t xcic_intl_probe_objects(lua_State *L, struct xcic_port *xp,
+				     const struct xcic_device_class *dc, uint32_t dst_addr,
+				     double timeout)
+{
+	size_t prefix_length = strlen(dc->name);
+
+	lua_newtable(L);
+
+	for (size_t i = 0; i < SCOM_NBR_ELEMENTS(xcic_objects); i++) {
+		const struct xcic_object *o = &xcic_objects[i];
+		char value[4];
+
+		if (o->object_type != SCOM_USER_INFO_OBJECT_TYPE ||
+		    strncmp(o->name, dc->name, prefix_length) || o->name[prefix_length] != '_')
+			continue;
+
+		/* values of other lengths are supported too, just not polled as numbers */
+		scom_error_t error = xcic_intl_probe(L, xp, dst_addr, o->object_id, timeout, value);
+
+		if (error == SCOM_ERROR_NO_ERROR || error == SCOM_ERROR_INVALID_DATA_LENGTH) {
+			lua_pushboolean(L, 1);
+			lua_rawseti(L, -2, o->object_id);
+		} else if (!xcic_intl_probe_answered(error) &&
+			   error != SCOM_ERROR_RESPONSE_TIMEOUT &&
+			   error != SCOM_ERROR_DEVICE_NOT_FOUND) {
+			return error;
+		}
+	}
+
+	return SCOM_ERROR_NO_ERROR;
+}
+
+const struct xcic_object *xcic_intl_object_find(scom_object_type_t object_type, uint32_t object_id)
+{
+	struct xcic_object key = {.object_type = object_type, .object_id = object_id};
+
+	return (const struct xcic_object *)bsearch(&key, xcic_objects,
+						   SCOM_NBR_ELEMENTS(xcic_objects),
+						   sizeof(xcic_objects[0]), xcic_intl_object_cmp);
+}
+
+int xcic_intl_object_check(lua_State *L, const struct xcic_object *object, size_t value_length)
+{
+	size_t expected;
+
+	switch (object->format) {
+	case SCOM_FORMAT_BOOL:
+		expected = 1;
+		break;
+	case SCOM_FORMAT_FORMAT:
+	case SCOM_FORMAT_ENUM:
+	case SCOM_FORMAT_ERROR:
+		expected = 2;
+		break;
+	case SCOM_FORMAT_INT32:
+	case SCOM_FORMAT_FLOAT:
+		expected = 4;
+		break;
+	default:
+		xcic_lua_except(L, "unsupported format %d of `%s`", object->format, object->name);
+	}
+
+	if (value_length != expected)
+		xcic_lua_except(L, "invalid `%s` length %d", object->name, (int)value_length);
+
+	return 0;
+
+except:
+	return -1; // caller must invoke `lua_error`
+}
+
+void xcic_intl_object_push(lua_State *L, const struct xcic_object *object, const char *value)
+{
+	switch (object->format) {
+	case SCOM_FORMAT_BOOL:
+		lua_pushboolean(L, *value);
+		break;
+	case SCOM_FORMAT_FORMAT:
+	case SCOM_FORMAT_ENUM:
+	case SCOM_FORMAT_ERROR:
+		lua_pushinteger(L, scom_read_le16(value));
+		break;
+	case SCOM_FORMAT_INT32:
+		lua_pushinteger(L, scom_read_le32(value));
+		break;
+	case SCOM_FORMAT_FLOAT:
+		lua_pushnumber(L, (lua_Number)scom_read_le_float(value));
+		break;
+	default:
+		lua_pushnil(L);
+		break;
+	}
+}
+
+/*
+ * Items may name the Prometheus metric of their value with `metric`, the
+ * catalog name is used otherwise.
+ */
+int xcic_intl_poll_list_parse(lua_State *L, int idx, const char *port_name, double period,
+			      struct xcic_poll_entry **entries, size_t *entry_count)
+{
+	size_t n = lua_objlen(L, idx);
+	double now = fiber_clock();
+
+	struct xcic_poll_entry *e = (struct xcic_poll_entry *)calloc(n ?: 1, sizeof(*e));
+	if (!e)
 		xcic_lua_except(L, "alloc failed");
 
-	memcpy(ibuf->rpos + offset, data, data_len);
+	for (size_t i = 0; i < n; i++) {
+		lua_rawgeti(L, idx, i + 1);
+		if (!lua_istable(L, -1)) {
+			lua_pop(L, 1);
+			xcic_intl_poll_list_free(e, i);
+			xcic_lua_except(L, "invalid poll entry #%d", (int)i + 1);
+		}
 
-	property->frame->buffer = ibuf->rpos;
-	property->frame->buffer_size = ibuf_used(ibuf);
-	property->value_length = data_len;
+		lua_rawgeti(L, -1, 1);
+		lua_rawgeti(L, -2, 2);
+		lua_rawgeti(L, -3, 3);
+		lua_rawgeti(L, -4, 4);
+		lua_getfield(L, -5, "period");
+		lua_getfield(L, -6, "priority");
+		lua_getfield(L, -7, "timeout");
+		lua_getfield(L, -8, "series");
+		lua_getfield(L, -9, "metric");
+
+		e[i].dst_addr = lua_tointeger(L, -9);
+		e[i].object_type = lua_tointeger(L, -8);
+		e[i].object_id = lua_tointeger(L, -7);
+		e[i].property_id = lua_isnil(L, -6) ? 1 : lua_tointeger(L, -6);
+		e[i].object = xcic_intl_object_find(e[i].object_type, e[i].object_id);
+		e[i].period = lua_isnil(L, -5) ? period : lua_tonumber(L, -5);
+		e[i].priority = lua_tointeger(L, -4);
+		e[i].timeout = lua_tonumber(L, -3);
+		e[i].series_id = lua_tointeger(L, -2);
+		e[i].due = now;
+
+		e[i].request.dst_addr = e[i].dst_addr;
+		e[i].request.object_type = e[i].object_type;
+		e[i].request.object_id = e[i].object_id;
+		e[i].request.property_id = e[i].property_id;
+
+		const char *metric = lua_tostring(L, -1);
+		if (!metric && e[i].object)
+			metric = e[i].object->name;
+
+		if (xcic_codec_prepare_read_property(&e[i].request)) {
+			lua_pop(L, 10);
+			xcic_intl_poll_list_free(e, i);
+			xcic_lua_except(L, "invalid poll entry #%d", (int)i + 1);
+		}
 
-	scom_encode_write_property(property);
+		if (!(e[i].period > 0)) {
+			lua_pop(L, 10);
+			xcic_intl_poll_list_free(e, i);
+			xcic_lua_except(L, "invalid period of poll entry #%d", (int)i + 1);
+		}
 
-	if (property->frame->last_error != SCOM_ERROR_NO_ERROR)
-		xcic_lua_except(L, "write property frame encoding failed with error %d (%s)",
-				property->frame->last_error,
-				xcic_scom_strerror(property->frame->last_error));
+		if (metric) {
+			e[i].metric = xcic_intl_metric_name(metric, port_name, &e[i].family_length);
+			if (!e[i].metric) {
+				lua_pop(L, 10);
+				xcic_intl_poll_list_free(e, i);
+				xcic_lua_except(L, "alloc failed");
+			}
+		}
+
+		lua_pop(L, 10);
+	}
+
+	*entries = e;
+	*entry_count = n;
 
 	return 0;
 
@@ -716,388 +5185,571 @@ except:
 	return -1; // caller must invoke `lua_error`
 }
 
-int xcic_scom_encode_request_frame(lua_State *L, struct ibuf *ibuf, scom_frame_t *frame)
+void xcic_intl_poll_list_free(struct xcic_poll_entry *entries, size_t entry_count)
+{
+	for (size_t i = 0; i < entry_count; i++) {
+		free(entries[i].series);
+		free(entries[i].metric);
+	}
+
+	free(entries);
+}
+
+/* `xci_<name>{port="<port>"}`, the name reduced to the characters Prometheus allows */
+char *xcic_intl_metric_name(const char *name, const char *port_name, size_t *family_length)
+{
+	size_t size = strlen("xci_") + strlen(name) + 1;
+	if (port_name)
+		size += strlen("{port=\"\"}") + strlen(port_name);
+
+	char *metric = (char *)malloc(size);
+	if (!metric)
+		return NULL;
+
+	char *p = metric + sprintf(metric, "xci_");
+
+	for (const char *c = name; *c; c++)
+		*p++ = isalnum((unsigned char)*c) || *c == '_' || *c == ':' ? *c : '_';
+
+	*family_length = p - metric;
+
+	if (port_name)
+		sprintf(p, "{port=\"%s\"}", port_name);
+	else
+		*p = '\0';
+
+	return metric;
+}
+
+struct xcic_poll_entry *xcic_intl_poll_entry_find(struct xcic_poller *poller,
+						  const struct xcic_poll_entry *key)
+{
+	for (size_t i = 0; i < poller->entry_count; i++) {
+		struct xcic_poll_entry *e = &poller->entries[i];
+
+		if (e->dst_addr == key->dst_addr && e->object_type == key->object_type &&
+		    e->object_id == key->object_id && e->property_id == key->property_id)
+			return e;
+	}
+
+	return NULL;
+}
+
+void xcic_intl_poll_entry_refresh(lua_State *L, struct xcic_port *xp,
+				  struct xcic_poll_entry *entry)
 {
-	if (!ibuf_alloc(ibuf, scom_frame_length(frame) - frame->buffer_size))
-		xcic_lua_except(L, "alloc failed");
+	scom_frame_t frame;
+	scom_initialize_frame(&frame, NULL, 0);
+
+	frame.src_addr = 1;
+	frame.dst_addr = entry->dst_addr;
 
-	frame->buffer = ibuf->rpos;
-	frame->buffer_size = ibuf_used(ibuf);
+	scom_property_t property;
+	scom_initialize_property(&property, &frame);
 
-	scom_encode_request_frame(frame);
+	property.object_type = entry->object_type;
+	property.object_id = entry->object_id;
+	property.property_id = entry->property_id;
 
-	if (frame->last_error != SCOM_ERROR_NO_ERROR)
-		xcic_lua_except(L, "data link frame encoding failed with error %d (%s)",
-				frame->last_error, xcic_scom_strerror(frame->last_error));
+	char value[XCIC_FRAME_DATA_SIZE_MAX];
 
-	return 0;
+	/* always from the wire, the result refreshes the cache */
+	if (xcic_intl_read_shared(L, xp, XCIC_PRIORITY_POLL, entry->timeout, 0, &entry->request,
+				  &property, value)) {
+		entry->last_error = frame.last_error ?: SCOM_ERROR_INVALID_FRAME;
+		snprintf(entry->last_errmsg, sizeof(entry->last_errmsg), "%s",
+			 lua_tostring(L, -1) ?: "unknown error");
+		lua_settop(L, 0);
+		return;
+	}
 
-except:
-	return -1; // caller must invoke `lua_error`
+	if (property.value_length > sizeof(entry->value)) {
+		entry->last_error = SCOM_ERROR_STACK_BUFFER_TOO_SMALL;
+		snprintf(entry->last_errmsg, sizeof(entry->last_errmsg),
+			 "value too long (%zu bytes)", property.value_length);
+		return;
+	}
+
+	if (entry->object && xcic_intl_object_check(L, entry->object, property.value_length)) {
+		entry->last_error = SCOM_ERROR_INVALID_DATA_LENGTH;
+		snprintf(entry->last_errmsg, sizeof(entry->last_errmsg), "%s", lua_tostring(L, -1));
+		lua_settop(L, 0);
+		return;
+	}
+
+	memcpy(entry->value, property.value_buffer, property.value_length);
+	entry->value_length = property.value_length;
+	entry->ts = xp->rx_ts;
+	entry->version++;
+	entry->last_error = SCOM_ERROR_NO_ERROR;
+	entry->last_errmsg[0] = '\0';
 }
 
-int xcic_scom_decode_frame_header(lua_State *L, scom_frame_t *frame)
+void xcic_intl_poll_entry_push(lua_State *L, const struct xcic_poll_entry *entry)
 {
-	scom_decode_frame_header(frame);
+	lua_createtable(L, 0, 10);
+
+	lua_pushinteger(L, entry->dst_addr);
+	lua_setfield(L, -2, "dst_addr");
+	lua_pushinteger(L, entry->object_type);
+	lua_setfield(L, -2, "object_type");
+	lua_pushinteger(L, entry->object_id);
+	lua_setfield(L, -2, "object_id");
+
+	if (entry->object) {
+		lua_pushstring(L, entry->object->name);
+		lua_setfield(L, -2, "name");
+	}
 
-	if (frame->last_error != SCOM_ERROR_NO_ERROR)
-		xcic_lua_except(L, "data link header decoding failed with error %d (%s)",
-				frame->last_error, xcic_scom_strerror(frame->last_error));
+	if (entry->version) {
+		if (entry->object)
+			xcic_intl_object_push(L, entry->object, entry->value);
+		else
+			lua_pushlstring(L, entry->value, entry->value_length);
+		lua_setfield(L, -2, "value");
+		lua_pushnumber(L, entry->ts);
+		lua_setfield(L, -2, "ts");
+	}
 
-	return 0;
+	lua_pushnumber(L, entry->version);
+	lua_setfield(L, -2, "version");
+	lua_pushnumber(L, entry->period);
+	lua_setfield(L, -2, "period");
+	lua_pushnumber(L, entry->missed);
+	lua_setfield(L, -2, "missed");
 
-except:
-	return -1; // caller must invoke `lua_error`
+	if (entry->last_error != SCOM_ERROR_NO_ERROR) {
+		lua_pushstring(L, entry->last_errmsg);
+		lua_setfield(L, -2, "error");
+	}
 }
 
-int xcic_scom_decode_frame_data(lua_State *L, scom_frame_t *frame)
+void xcic_intl_poll_entry_commit(struct xcic_poll_entry *entry,
+				 const struct xcic_poll_entry *result)
 {
-	scom_decode_frame_data(frame);
-
-	if (frame->last_error != SCOM_ERROR_NO_ERROR)
-		xcic_lua_except(L, "data link data decoding failed with error %d (%s)",
-				frame->last_error, xcic_scom_strerror(frame->last_error));
+	memcpy(entry->value, result->value, result->value_length);
+	entry->value_length = result->value_length;
+	entry->ts = result->ts;
+	entry->version = result->version;
+	entry->last_error = result->last_error;
+	memcpy(entry->last_errmsg, result->last_errmsg, sizeof(entry->last_errmsg));
+}
 
-	return 0;
+void xcic_intl_subscriptions_notify(struct xcic_port *xp, const struct xcic_poll_entry *entry)
+{
+	struct xcic_subscription *sub;
 
-except:
-	return -1; // caller must invoke `lua_error`
+	rlist_foreach_entry(sub, &xp->subscriptions, link) {
+		if (sub->dst_addr == entry->dst_addr && sub->object_type == entry->object_type &&
+		    sub->object_id == entry->object_id && sub->property_id == entry->property_id)
+			xcic_intl_subscription_notify(sub, entry);
+	}
 }
 
-int xcic_scom_decode_read_property(lua_State *L, scom_property_t *property)
+void xcic_intl_subscription_notify(struct xcic_subscription *sub,
+				   const struct xcic_poll_entry *entry)
 {
-	scom_decode_read_property(property);
+	if (entry->last_error != SCOM_ERROR_NO_ERROR) {
+		if (entry->last_error == sub->error)
+			return;
+	} else if (sub->error == SCOM_ERROR_NO_ERROR && sub->value_length) {
+		if (sub->deadband > 0 && sub->object && sub->object->format == SCOM_FORMAT_FLOAT) {
+			double delta = (double)scom_read_le_float(entry->value) -
+				       (double)scom_read_le_float(sub->value);
+			if (delta < sub->deadband && delta > -sub->deadband)
+				return;
+		} else if (entry->value_length == sub->value_length &&
+			   !memcmp(entry->value, sub->value, entry->value_length)) {
+			return;
+		}
+	}
 
-	if (property->frame->last_error != SCOM_ERROR_NO_ERROR)
-		xcic_lua_except(L, "read property decoding failed with error %d (%s)",
-				property->frame->last_error,
-				xcic_scom_strerror(property->frame->last_error));
+	if (sub->count == sub->capacity) {
+		sub->head = (sub->head + 1) % sub->capacity;
+		sub->count--;
+		sub->dropped++;
+	}
 
-	return 0;
+	struct xcic_event *event = &sub->events[(sub->head + sub->count) % sub->capacity];
 
-except:
-	return -1; // caller must invoke `lua_error`
-}
+	sub->count++;
 
-int xcic_scom_decode_write_property(lua_State *L, scom_property_t *property)
-{
-	scom_decode_write_property(property);
+	event->error = entry->last_error;
+	event->ts = entry->ts;
+	event->version = entry->version;
 
-	if (property->frame->last_error != SCOM_ERROR_NO_ERROR)
-		xcic_lua_except(L, "write property decoding failed with error %d (%s)",
-				property->frame->last_error,
-				xcic_scom_strerror(property->frame->last_error));
+	if (entry->last_error != SCOM_ERROR_NO_ERROR) {
+		event->ts = clock_realtime();
+		memcpy(event->errmsg, entry->last_errmsg, sizeof(event->errmsg));
+	} else {
+		memcpy(event->value, entry->value, entry->value_length);
+		event->value_length = entry->value_length;
+		memcpy(sub->value, entry->value, entry->value_length);
+		sub->value_length = entry->value_length;
+	}
 
-	return 0;
+	sub->error = entry->last_error;
 
-except:
-	return -1; // caller must invoke `lua_error`
+	fiber_cond_broadcast(sub->cond);
 }
 
-char *xcic_scom_strerror(scom_error_t error)
-{
-	switch (error) {
-	case SCOM_ERROR_NO_ERROR:
-		return "no_error";
-	case SCOM_ERROR_INVALID_FRAME:
-		return "invalid_frame";
-	case SCOM_ERROR_DEVICE_NOT_FOUND:
-		return "device_not_found";
-	case SCOM_ERROR_RESPONSE_TIMEOUT:
-		return "response_timeout";
-	case SCOM_ERROR_SERVICE_NOT_SUPPORTED:
-		return "service_not_supported";
-	case SCOM_ERROR_INVALID_SERVICE_ARGUMENT:
-		return "invalid_service_argument";
-	case SCOM_ERROR_GATEWAY_BUSY:
-		return "gateway_busy";
-	case SCOM_ERROR_TYPE_NOT_SUPPORTED:
-		return "type_not_supported";
-	case SCOM_ERROR_OBJECT_ID_NOT_FOUND:
-		return "object_id_not_found";
-	case SCOM_ERROR_PROPERTY_NOT_SUPPORTED:
-		return "property_not_supported";
-	case SCOM_ERROR_INVALID_DATA_LENGTH:
-		return "invalid_data_length";
-	case SCOM_ERROR_PROPERTY_IS_READ_ONLY:
-		return "property_is_read_only";
-	case SCOM_ERROR_INVALID_DATA:
-		return "invalid_data";
-	case SCOM_ERROR_DATA_TOO_SMALL:
-		return "data_too_small";
-	case SCOM_ERROR_DATA_TOO_BIG:
-		return "data_too_big";
-	case SCOM_ERROR_WRITE_PROPERTY_FAILED:
-		return "write_property_failed";
-	case SCOM_ERROR_READ_PROPERTY_FAILED:
-		return "read_property_failed";
-	case SCOM_ERROR_ACCESS_DENIED:
-		return "access_denied";
-	case SCOM_ERROR_OBJECT_NOT_SUPPORTED:
-		return "object_not_supported";
-	case SCOM_ERROR_MULTICAST_READ_NOT_SUPPORTED:
-		return "multicast_read_not_supported";
-	case SCOM_ERROR_INVALID_SHELL_ARG:
-		return "invalid_shell_arg";
-	case SCOM_ERROR_STACK_PORT_NOT_FOUND:
-		return "stack_port_not_found";
-	case SCOM_ERROR_STACK_PORT_INIT_FAILED:
-		return "stack_port_init_failed";
-	case SCOM_ERROR_STACK_PORT_WRITE_FAILED:
-		return "stack_port_write_failed";
-	case SCOM_ERROR_STACK_PORT_READ_FAILED:
-		return "stack_port_read_failed";
-	case SCOM_ERROR_STACK_BUFFER_TOO_SMALL:
-		return "stack_buffer_too_small";
-	case SCOM_ERROR_STACK_PROPERTY_HEADER_DOESNT_MATCH:
-		return "stack_property_header_doesnt_match";
-	default:
-		return "unknown";
-	}
+/* detached subscribers are woken up and see the subscription closed */
+void xcic_intl_subscriptions_detach(lua_State *L, struct xcic_port *xp)
+{
+	struct xcic_subscription *sub, *tmp;
+
+	rlist_foreach_entry_safe(sub, &xp->subscriptions, link, tmp)
+		xcic_intl_subscription_detach(L, sub);
 }
 
-int xcic_pack_le32(lua_State *L)
+void xcic_intl_subscription_detach(lua_State *L, struct xcic_subscription *sub)
 {
-	if (lua_gettop(L) < 1)
-		return luaL_error(L, "Usage: xcic.pack_le32(val)");
+	if (!sub->xp)
+		return;
 
-	uint32_t val;
-	scom_write_le32((char *const) & val, (uint32_t)lua_tointeger(L, 1));
+	rlist_del(&sub->link);
+	sub->xp = NULL;
 
-	lua_pushlstring(L, (const char *)&val, 4);
+	luaL_unref(L, LUA_REGISTRYINDEX, sub->port_ref);
+	sub->port_ref = LUA_NOREF;
 
-	return 1;
+	if (sub->cond)
+		fiber_cond_broadcast(sub->cond);
 }
 
-int xcic_unpack_le32(lua_State *L)
+/*
+ * Earliest deadline first: of the entries that are due, pick the one whose
+ * deadline (due + period) comes first. A linear scan is cheaper than keeping
+ * a heap for the few dozen objects a site polls.
+ */
+struct xcic_poll_entry *xcic_intl_poller_next(struct xcic_poller *poller, double now,
+					      double *wait)
 {
-	if (lua_gettop(L) < 1)
-		return luaL_error(L, "Usage: xcic.unpack_le32(data)");
+	struct xcic_poll_entry *next = NULL;
+	double next_due = TIMEOUT_INFINITY;
 
-	size_t data_len;
-	const char *data = lua_tolstring(L, 1, &data_len);
+	for (size_t i = 0; i < poller->entry_count; i++) {
+		struct xcic_poll_entry *e = &poller->entries[i];
 
-	if (data_len != 4)
-		xcic_lua_except(L, "invalid le32 length %d", data_len);
+		if (e->due > now) {
+			if (e->due < next_due)
+				next_due = e->due;
+			continue;
+		}
 
-	lua_pushinteger(L, scom_read_le32(data));
+		if (!next)
+			next = e;
+		else if (e->due + e->period < next->due + next->period)
+			next = e;
+		else if (e->due + e->period == next->due + next->period &&
+			 e->priority < next->priority)
+			next = e;
+	}
 
-	return 1;
+	*wait = next ? 0 : next_due - now;
 
-except:
-	return lua_error(L);
+	return next;
 }
 
-int xcic_pack_le16(lua_State *L)
+int xcic_intl_poller_f(va_list ap)
 {
-	if (lua_gettop(L) < 1)
-		return luaL_error(L, "Usage: xcic.pack_le16(val)");
+	struct xcic_port *xp = va_arg(ap, struct xcic_port *);
+	struct xcic_poller *poller = xp->poller;
 
-	uint16_t val;
-	scom_write_le16((char *const) & val, (uint16_t)lua_tointeger(L, 1));
+	while (!fiber_is_cancelled()) {
+		double wait;
+		struct xcic_poll_entry *entry = xcic_intl_poller_next(poller, fiber_clock(), &wait);
 
-	lua_pushlstring(L, (const char *)&val, 2);
+		if (!entry) {
+			poller->idle = true;
+			fiber_sleep(wait);
+			poller->idle = false;
+			continue;
+		}
 
-	return 1;
-}
+		/* the entries may be replaced while the exchange yields */
+		struct xcic_poll_entry result = *entry;
+		uint64_t plan_version = poller->plan_version;
 
-int xcic_unpack_le16(lua_State *L)
-{
-	if (lua_gettop(L) < 1)
-		return luaL_error(L, "Usage: xcic.unpack_le16(data)");
+		xcic_intl_poll_entry_refresh(poller->L, xp, &result);
 
-	size_t data_len;
-	const char *data = lua_tolstring(L, 1, &data_len);
+		if (plan_version != poller->plan_version) {
+			entry = xcic_intl_poll_entry_find(poller, &result);
+			if (!entry)
+				continue;
+		}
 
-	if (data_len != 2)
-		xcic_lua_except(L, "invalid le16 length %d", data_len);
+		xcic_intl_poll_entry_commit(entry, &result);
+		xcic_intl_subscriptions_notify(xp, entry);
 
-	lua_pushinteger(L, scom_read_le16(data));
+		if (xp->history && entry->series_id && entry->last_error == SCOM_ERROR_NO_ERROR)
+			xcic_intl_series_record(xp, entry);
 
-	return 1;
+		double now = fiber_clock();
 
-except:
-	return lua_error(L);
-}
+		if (now > entry->due + entry->period) {
+			entry->missed++;
+			poller->missed++;
+		}
 
-int xcic_pack_le_float(lua_State *L)
-{
-	if (lua_gettop(L) < 1)
-		return luaL_error(L, "Usage: xcic.pack_le_float(val)");
+		entry->due += entry->period;
+		if (entry->due < now)
+			entry->due = now;
 
-	uint32_t val;
-	scom_write_le_float((char *const) & val, (float)lua_tonumber(L, 1));
+		poller->generation++;
+		poller->ts = clock_realtime();
+	}
 
-	lua_pushlstring(L, (const char *)&val, 4);
+	return 0;
+}
 
-	return 1;
+void xcic_intl_poller_delete(lua_State *L, struct xcic_poller *poller)
+{
+	luaL_unref(L, LUA_REGISTRYINDEX, poller->L_ref);
+	luaL_unref(L, LUA_REGISTRYINDEX, poller->port_ref);
+
+	xcic_intl_poll_list_free(poller->entries, poller->entry_count);
+	free(poller);
 }
 
-int xcic_unpack_le_float(lua_State *L)
+void xcic_intl_poller_stop(lua_State *L, struct xcic_port *xp)
 {
-	if (lua_gettop(L) < 1)
-		return luaL_error(L, "Usage: xcic.unpack_le_float(data)");
+	struct xcic_poller *poller = xp->poller;
 
-	size_t data_len;
-	const char *data = lua_tolstring(L, 1, &data_len);
+	if (!poller)
+		return;
 
-	if (data_len != 4)
-		xcic_lua_except(L, "invalid le float length %d", data_len);
+	fiber_cancel(poller->fiber);
+	fiber_join(poller->fiber);
+	poller->fiber = NULL;
 
-	lua_pushnumber(L, (lua_Number)scom_read_le_float(data));
+	for (size_t i = 0; i < poller->entry_count; i++)
+		xcic_intl_series_flush(xp, &poller->entries[i]);
 
-	return 1;
+	xp->poller = NULL;
+	xcic_intl_poller_delete(L, poller);
+}
 
-except:
-	return lua_error(L);
+int xcic_intl_object_number(const struct xcic_object *object, const char *value, double *number)
+{
+	switch (object->format) {
+	case SCOM_FORMAT_BOOL:
+		*number = *value ? 1 : 0;
+		break;
+	case SCOM_FORMAT_FORMAT:
+	case SCOM_FORMAT_ENUM:
+	case SCOM_FORMAT_ERROR:
+		*number = scom_read_le16(value);
+		break;
+	case SCOM_FORMAT_INT32:
+		*number = (int32_t)scom_read_le32(value);
+		break;
+	case SCOM_FORMAT_FLOAT:
+		*number = scom_read_le_float(value);
+		break;
+	default:
+		return -1;
+	}
+
+	return 0;
 }
 
-int xcic_pack_bool(lua_State *L)
+/*
+ * Appends the value just read to the open block of the entry and to the
+ * rollup buckets. Full blocks and finished buckets are written, and once a
+ * minute the open block and buckets are written in place as they stand, so
+ * a sample costs no WAL write of its own and a crash loses a minute at most.
+ */
+void xcic_intl_series_record(struct xcic_port *xp, struct xcic_poll_entry *entry)
 {
-	if (lua_gettop(L) < 1)
-		return luaL_error(L, "Usage: xcic.pack_bool(val)");
+	double value;
 
-	uint8_t val = (uint8_t)lua_toboolean(L, 1);
+	if (!entry->object || xcic_intl_object_number(entry->object, entry->value, &value))
+		return;
 
-	lua_pushlstring(L, (const char *)&val, 1);
+	struct xcic_series *series = entry->series;
 
-	return 1;
-}
+	if (!series) {
+		series = (struct xcic_series *)calloc(1, sizeof(*series));
+		if (!series)
+			return;
 
-int xcic_unpack_bool(lua_State *L)
-{
-	if (lua_gettop(L) < 1)
-		return luaL_error(L, "Usage: xcic.unpack_bool(data)");
+		xcic_series_block_init(&series->block);
+		series->rollups[0].period = 60;
+		series->rollups[1].period = 3600;
 
-	size_t data_len;
-	const char *data = lua_tolstring(L, 1, &data_len);
+		entry->series = series;
+	}
 
-	if (data_len != 1)
-		xcic_lua_except(L, "invalid bool length %d", data_len);
+	uint64_t ts = (uint64_t)(entry->ts * 1000);
 
-	lua_pushboolean(L, *data);
+	if (xcic_series_block_append(&series->block, ts, value)) {
+		xcic_intl_series_write_block(xp, entry);
+		xcic_series_block_init(&series->block);
+		(void)xcic_series_block_append(&series->block, ts, value);
+	}
 
-	return 1;
+	bool minute = false;
 
-except:
-	return lua_error(L);
+	for (int t = 0; t < XCIC_HISTORY_TIER_MAX - 1; t++) {
+		struct xcic_series_rollup done;
+
+		if (!xcic_series_rollup_add(&series->rollups[t], ts / 1000, value, &done))
+			continue;
+
+		xcic_intl_series_write_rollup(xp, entry, t, &done);
+
+		if (t == 0)
+			minute = true;
+	}
+
+	if (minute) {
+		xcic_intl_series_write_block(xp, entry);
+		xcic_intl_series_write_rollup(xp, entry, 1, &series->rollups[1]);
+	}
 }
 
-int xcic_pack_signal(lua_State *L)
+/* writes the open block and buckets of the entry, if any, and starts a new block */
+void xcic_intl_series_flush(struct xcic_port *xp, struct xcic_poll_entry *entry)
 {
-	uint32_t val = 1;
+	struct xcic_series *series = entry->series;
 
-	lua_pushlstring(L, (const char *)&val, 4);
+	if (!series)
+		return;
 
-	return 1;
+	xcic_intl_series_write_block(xp, entry);
+
+	for (int t = 0; t < XCIC_HISTORY_TIER_MAX - 1; t++)
+		xcic_intl_series_write_rollup(xp, entry, t, &series->rollups[t]);
+
+	xcic_series_block_init(&series->block);
 }
 
-int xcic_unpack_software_version(lua_State *L)
+/* the block is keyed by its first sample, writing it again as it grows replaces it */
+void xcic_intl_series_write_block(struct xcic_port *xp, struct xcic_poll_entry *entry)
 {
-	if (lua_gettop(L) < 1)
-		return luaL_error(L, "Usage: xcic.unpack_software_version(msb_data, lsb_data)");
+	struct xcic_series *series = entry->series;
 
-	size_t msb_data_len;
-	const char *msb_data = lua_tolstring(L, 1, &msb_data_len);
+	if (!series || !series->block.count || !xp->history)
+		return;
 
-	if (msb_data_len != 4)
-		xcic_lua_except(L, "invalid msb data length %d", msb_data_len);
+	size_t size = xcic_series_block_size(&series->block);
 
-	size_t lsb_data_len;
-	const char *lsb_data = lua_tolstring(L, 2, &lsb_data_len);
+	char tuple[32 + XCIC_SERIES_BLOCK_SIZE], prefix[8];
+	char *p = tuple, *k = prefix;
 
-	if (lsb_data_len != 4)
-		xcic_lua_except(L, "invalid lsb data length %d", lsb_data_len);
+	p = mp_encode_array(p, 4);
+	p = mp_encode_uint(p, entry->series_id);
+	p = mp_encode_uint(p, series->block.t0);
+	p = mp_encode_uint(p, series->block.count);
+	p = mp_encode_bin(p, (const char *)series->block.data, size);
 
-	uint16_t msb = (uint16_t)scom_read_le_float(msb_data);
-	uint16_t lsb = (uint16_t)scom_read_le_float(lsb_data);
+	k = mp_encode_array(k, 1);
+	k = mp_encode_uint(k, entry->series_id);
 
-	lua_pushfstring(L, "%d.%d.%d", msb >> 8, lsb >> 8, lsb & 0xFF);
+	double cutoff = (clock_realtime() - xp->history->retention[XCIC_HISTORY_RAW]) * 1000;
 
-	return 1;
+	if (xcic_intl_history_write(xp->history->block_space_id, tuple, p, prefix, k, 1,
+				    cutoff > 0 ? cutoff : 0))
+		say_warn("xcic: history block %u: %s", entry->series_id,
+			 box_error_message(box_error_last()));
+}
 
-except:
-	return lua_error(L);
+/* `tier` 0 for 1 min buckets, 1 for 1 h ones; an open bucket is replaced once done */
+void xcic_intl_series_write_rollup(struct xcic_port *xp, struct xcic_poll_entry *entry,
+				   int tier, const struct xcic_series_rollup *rollup)
+{
+	if (!rollup->count || !xp->history)
+		return;
+
+	char tuple[64], prefix[16];
+	char *p = tuple, *k = prefix;
+
+	p = mp_encode_array(p, 7);
+	p = mp_encode_uint(p, entry->series_id);
+	p = mp_encode_uint(p, rollup->period);
+	p = mp_encode_uint(p, rollup->bucket);
+	p = mp_encode_double(p, rollup->min);
+	p = mp_encode_double(p, rollup->max);
+	p = mp_encode_double(p, rollup->sum / rollup->count);
+	p = mp_encode_uint(p, rollup->count);
+
+	k = mp_encode_array(k, 2);
+	k = mp_encode_uint(k, entry->series_id);
+	k = mp_encode_uint(k, rollup->period);
+
+	double cutoff = clock_realtime() - xp->history->retention[tier + 1];
+
+	if (xcic_intl_history_write(xp->history->rollup_space_id, tuple, p, prefix, k, 2,
+				    cutoff > 0 ? cutoff : 0))
+		say_warn("xcic: history rollup %u: %s", entry->series_id,
+			 box_error_message(box_error_last()));
 }
 
-ssize_t xcic_intl_port_read(struct xcic_port *xp, void *buf, size_t count)
+/*
+ * Replaces the tuple and drops a few of the oldest tuples under `prefix`
+ * whose timestamp field is older than `cutoff`, in one transaction.
+ */
+int xcic_intl_history_write(uint32_t space_id, const char *tuple, const char *tuple_end,
+			    const char *prefix, const char *prefix_end, uint32_t fieldno,
+			    uint64_t cutoff)
 {
-	size_t l = count;
-	ssize_t n = 0;
-	void *p = buf;
+	if (box_txn_begin())
+		return -1;
 
-	while (l > 0) {
-		if (xp->fd == -1)
-			break;
+	if (box_replace(space_id, tuple, tuple_end, NULL))
+		goto rollback;
 
-		int w = coio_wait(xp->fd, COIO_READ, 100);
-		if (xp->fd == -1 || fiber_is_cancelled())
-			break;
-		else if (!(w & COIO_READ))
-			continue;
+	for (int i = 0; i < XCIC_HISTORY_PRUNE_MAX; i++) {
+		box_iterator_t *it = box_index_iterator(space_id, 0, ITER_EQ, prefix, prefix_end);
+		if (!it)
+			goto rollback;
 
-		n = read(xp->fd, p, l);
+		box_tuple_t *oldest;
+		int rc = box_iterator_next(it, &oldest);
+		box_iterator_free(it);
 
-		if (n == 0)
+		if (rc)
+			goto rollback;
+		if (!oldest)
 			break;
-		else if (n == -1 && errno == EAGAIN)
-			continue;
-		else if (n == -1)
-			return n;
-
-		l -= n;
-		p += n;
-	}
-
-	return count - l;
-}
-
-ssize_t xcic_intl_port_write(struct xcic_port *xp, void *buf, size_t count)
-{
-	size_t l = count;
-	ssize_t n = 0;
-	void *p = buf;
 
-	while (l > 0) {
-		if (xp->fd == -1)
+		const char *field = box_tuple_field(oldest, fieldno);
+		if (!field || mp_typeof(*field) != MP_UINT)
 			break;
 
-		int w = coio_wait(xp->fd, COIO_WRITE, 100);
-		if (xp->fd == -1 || fiber_is_cancelled())
+		uint64_t ts = mp_decode_uint(&field);
+		if (ts >= cutoff)
 			break;
-		else if (!(w & COIO_WRITE))
-			continue;
 
-		n = write(xp->fd, p, l);
+		/* the primary key is the prefix followed by the timestamp */
+		char key[32];
+		const char *pos = prefix;
+		uint32_t parts = mp_decode_array(&pos);
+		char *k = mp_encode_array(key, parts + 1);
 
-		if (n == 0)
-			break;
-		else if (n == -1 && errno == EAGAIN)
-			continue;
-		else if (n == -1)
-			return n;
+		memcpy(k, pos, prefix_end - pos);
+		k += prefix_end - pos;
+		k = mp_encode_uint(k, ts);
 
-		l -= n;
-		p += n;
+		if (box_delete(space_id, 0, key, k, NULL))
+			goto rollback;
 	}
 
-	return count - l;
-}
+	return box_txn_commit();
 
-void xcic_intl_port_close(struct xcic_port *xp)
-{
-	int fd = xp->fd;
-	xp->fd = -1;
+rollback:
+	(void)box_txn_rollback();
 
-	(void)coio_close(fd);
+	return -1;
 }
 
-ssize_t xcic_intl_open_cb(va_list ap)
+int xcic_intl_metric_cmp(const void *a, const void *b)
 {
-	char *pathname = va_arg(ap, char *);
-	int flags = va_arg(ap, int);
+	const struct xcic_poll_entry *l = *(const struct xcic_poll_entry *const *)a;
+	const struct xcic_poll_entry *r = *(const struct xcic_poll_entry *const *)b;
 
-	return open(pathname, flags);
+	return strcmp(l->metric, r->metric);
 }
 
 /*
@@ -1108,7 +5760,11 @@ struct define {
 	int value;
 };
 
-static const struct define defines[] = {{"FRAME_HEADER_SIZE", SCOM_FRAME_HEADER_SIZE}, {NULL, 0}};
+static const struct define defines[] = {{"FRAME_HEADER_SIZE", SCOM_FRAME_HEADER_SIZE},
+				       {"USER_INFO_OBJECT_TYPE", SCOM_USER_INFO_OBJECT_TYPE},
+				       {"PARAMETER_OBJECT_TYPE", SCOM_PARAMETER_OBJECT_TYPE},
+				       {"MESSAGE_OBJECT_TYPE", 3},
+				       {NULL, 0}};
 
 /*
  * Lists of exporting: object and/or functions to the Lua
@@ -1116,6 +5772,15 @@ static const struct define defines[] = {{"FRAME_HEADER_SIZE", SCOM_FRAME_HEADER_
 
 static const struct luaL_Reg R[] = {{"open_port", xcic_open_port},
 				    {"calc_checksum", xcic_calc_checksum},
+				    {"prepare_read", xcic_prepare_read},
+				    {"port", xcic_port},
+				    {"ports", xcic_ports},
+				    {"merged_snapshot", xcic_merged_snapshot},
+				    {"load_datalog", xcic_load_datalog},
+				    {"load_datalog_dir", xcic_load_datalog_dir},
+				    {"message_text", xcic_message_text},
+				    {"decode_series", xcic_decode_series},
+				    {"render_metrics", xcic_render_metrics},
 				    {"pack_le32", xcic_pack_le32},
 				    {"unpack_le32", xcic_unpack_le32},
 				    {"pack_le16", xcic_pack_le16},
@@ -1131,15 +5796,48 @@ static const struct luaL_Reg R[] = {{"open_port", xcic_open_port},
 static const struct luaL_Reg M[] = {
     {"close", xcic_port_close},
     {"usable", xcic_port_usable},
+    {"set_timeouts", xcic_port_set_timeouts},
+    {"get_timeouts", xcic_port_get_timeouts},
+    {"set_history", xcic_port_set_history},
+    {"start_capture", xcic_port_start_capture},
+    {"stop_capture", xcic_port_stop_capture},
+    {"stats", xcic_port_stats},
+    {"set_frame_ring", xcic_port_set_frame_ring},
+    {"set_cache", xcic_port_set_cache},
+    {"frames", xcic_port_frames},
     {"read_user_info", xcic_port_read_user_info},
     {"read_parameter_property", xcic_port_read_parameter_property},
+    {"read_user_info_typed", xcic_port_read_user_info_typed},
+    {"read_parameter_typed", xcic_port_read_parameter_typed},
+    {"read_many", xcic_port_read_many},
+    {"read_prepared", xcic_port_read_prepared},
+    {"set_fleet", xcic_port_set_fleet},
+    {"get_fleet", xcic_port_get_fleet},
+    {"read_fleet", xcic_port_read_fleet},
+    {"discover", xcic_port_discover},
     {"write_parameter_property", xcic_port_write_parameter_property},
     {"read_message", xcic_port_read_message},
+    {"sync_messages", xcic_port_sync_messages},
     {"read_datalog_dir", xcic_port_read_datalog_dir},
     {"read_datalog_file", xcic_port_read_datalog_file},
+    {"stream_datalog_file", xcic_port_stream_datalog_file},
+    {"read_datalog_index", xcic_port_read_datalog_index},
+    {"start_poller", xcic_port_start_poller},
+    {"stop_poller", xcic_port_stop_poller},
+    {"reload_poller", xcic_port_reload_poller},
+    {"snapshot", xcic_port_snapshot},
+    {"subscribe", xcic_port_subscribe},
     {"__tostring", xcic_port_to_string},
     {"__gc", xcic_port_gc},
     {NULL, NULL}};
+static const struct luaL_Reg S[] = {
+    {"get", xcic_subscription_get},
+    {"count", xcic_subscription_count},
+    {"dropped", xcic_subscription_dropped},
+    {"is_closed", xcic_subscription_is_closed},
+    {"close", xcic_subscription_close},
+    {"__gc", xcic_subscription_gc},
+    {NULL, NULL}};
 /*
  * ]]
  */
@@ -1149,6 +5847,15 @@ static const struct luaL_Reg M[] = {
  */
 LUA_API int luaopen_xcic(lua_State *L)
 {
+	luaL_newmetatable(L, XCIC_SUBSCRIPTION_LUA_UDATA_NAME);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -2, "__index");
+	luaL_register(L, NULL, S);
+	lua_pop(L, 1);
+
+	luaL_newmetatable(L, XCIC_REQUEST_LUA_UDATA_NAME);
+	lua_pop(L, 1);
+
 	/**
 	 * Add metatable.__index = metatable
 	 */
@@ -0,0 +1,73 @@
+/*
+Copyright (c) 2020 Maxim Galaganov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "xcic_capture.h"
+
+static void xcic_capture_write_le(char *buf, uint64_t value, int size);
+static uint64_t xcic_capture_read_le(const char *buf, int size);
+
+char *xcic_capture_encode_header(char *buf, uint64_t ts, enum xcic_capture_kind kind,
+				 uint16_t length)
+{
+	xcic_capture_write_le(buf, ts, 8);
+	buf[8] = (char)kind;
+	buf[9] = 0;
+	xcic_capture_write_le(buf + 10, length, 2);
+
+	return buf + XCIC_CAPTURE_HEADER_SIZE;
+}
+
+int xcic_capture_next(const char **pos, const char *end, struct xcic_capture_record *record)
+{
+	if (*pos == end)
+		return 0;
+
+	if (end - *pos < XCIC_CAPTURE_HEADER_SIZE)
+		return -1;
+
+	record->ts = xcic_capture_read_le(*pos, 8);
+	record->kind = (enum xcic_capture_kind)(uint8_t)(*pos)[8];
+	record->length = xcic_capture_read_le(*pos + 10, 2);
+	record->data = *pos + XCIC_CAPTURE_HEADER_SIZE;
+
+	if ((size_t)(end - record->data) < record->length)
+		return -1;
+
+	*pos = record->data + record->length;
+
+	return 1;
+}
+
+void xcic_capture_write_le(char *buf, uint64_t value, int size)
+{
+	for (int i = 0; i < size; i++, value >>= 8)
+		buf[i] = (char)(value & 0xff);
+}
+
+uint64_t xcic_capture_read_le(const char *buf, int size)
+{
+	uint64_t value = 0;
+
+	for (int i = size - 1; i >= 0; i--)
+		value = (value << 8) | (uint8_t)buf[i];
+
+	return value;
+}
@@ -0,0 +1,66 @@
+/*
+Copyright (c) 2020 Maxim Galaganov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef XCIC_CAPTURE_H
+#define XCIC_CAPTURE_H
+
+/*
+ * Serial traffic capture file format, shared by the module writing it and
+ * xcireplay reading it back.
+ *
+ * A file starts with XCIC_CAPTURE_MAGIC, then records follow back to back:
+ * a 12 byte header (monotonic time in ns as le64, kind, a reserved byte,
+ * payload length as le16) and the payload. TX and RX records hold the bytes
+ * as written to and read from the port; an ERROR record holds the le16
+ * scom_error_t an exchange failed with.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define XCIC_CAPTURE_MAGIC "XCICAP01"
+#define XCIC_CAPTURE_MAGIC_SIZE 8
+#define XCIC_CAPTURE_HEADER_SIZE 12
+
+enum xcic_capture_kind {
+	XCIC_CAPTURE_TX = 1,
+	XCIC_CAPTURE_RX = 2,
+	XCIC_CAPTURE_ERROR = 3,
+};
+
+struct xcic_capture_record {
+	uint64_t ts;
+	enum xcic_capture_kind kind;
+	const char *data;
+	size_t length;
+};
+
+/** Writes a record header for `length` payload bytes to `buf`, returns its end. */
+char *xcic_capture_encode_header(char *buf, uint64_t ts, enum xcic_capture_kind kind,
+				 uint16_t length);
+
+/*
+ * Reads the record at `*pos` and moves past it. Returns 1, 0 at the end or
+ * -1 if the record is truncated.
+ */
+int xcic_capture_next(const char **pos, const char *end, struct xcic_capture_record *record);
+
+#endif /* XCIC_CAPTURE_H */
@@ -0,0 +1,186 @@
+/*
+Copyright (c) 2020 Maxim Galaganov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "xcic_codec.h"
+
+#include <string.h>
+
+int xcic_codec_encode_read_property(struct ibuf *ibuf, scom_property_t *property,
+				    const char *data, size_t data_len)
+{
+	size_t offset = SCOM_FRAME_HEADER_SIZE + 2 + 8;
+
+	if (!ibuf_alloc(ibuf, offset + data_len)) {
+		property->frame->last_error = SCOM_ERROR_STACK_BUFFER_TOO_SMALL;
+		return -1;
+	}
+
+	memcpy(ibuf->rpos + offset, data, data_len);
+
+	property->frame->buffer = ibuf->rpos;
+	property->frame->buffer_size = ibuf_used(ibuf);
+	property->value_length = data_len;
+
+	scom_encode_read_property(property);
+
+	/* scom_encode_read_property() resets `property->value_length` */
+	property->value_length = data_len;
+	property->frame->data_length += property->value_length;
+
+	return property->frame->last_error != SCOM_ERROR_NO_ERROR ? -1 : 0;
+}
+
+int xcic_codec_encode_write_property(struct ibuf *ibuf, scom_property_t *property,
+				     const char *data, size_t data_len)
+{
+	size_t offset = SCOM_FRAME_HEADER_SIZE + 2 + 8;
+
+	if (!ibuf_alloc(ibuf, offset + data_len)) {
+		property->frame->last_error = SCOM_ERROR_STACK_BUFFER_TOO_SMALL;
+		return -1;
+	}
+
+	memcpy(ibuf->rpos + offset, data, data_len);
+
+	property->frame->buffer = ibuf->rpos;
+	property->frame->buffer_size = ibuf_used(ibuf);
+	property->value_length = data_len;
+
+	scom_encode_write_property(property);
+
+	return property->frame->last_error != SCOM_ERROR_NO_ERROR ? -1 : 0;
+}
+
+int xcic_codec_encode_request_frame(struct ibuf *ibuf, scom_frame_t *frame)
+{
+	if (!ibuf_alloc(ibuf, scom_frame_length(frame) - frame->buffer_size)) {
+		frame->last_error = SCOM_ERROR_STACK_BUFFER_TOO_SMALL;
+		return -1;
+	}
+
+	frame->buffer = ibuf->rpos;
+	frame->buffer_size = ibuf_used(ibuf);
+
+	scom_encode_request_frame(frame);
+
+	return frame->last_error != SCOM_ERROR_NO_ERROR ? -1 : 0;
+}
+
+int xcic_codec_prepare_read_property(struct xcic_request *request)
+{
+	scom_frame_t frame;
+	scom_initialize_frame(&frame, request->frame, sizeof(request->frame));
+
+	frame.src_addr = 1;
+	frame.dst_addr = request->dst_addr;
+
+	scom_property_t property;
+	scom_initialize_property(&property, &frame);
+
+	property.object_type = request->object_type;
+	property.object_id = request->object_id;
+	property.property_id = request->property_id;
+
+	scom_encode_read_property(&property);
+	scom_encode_request_frame(&frame);
+
+	request->length = scom_frame_length(&frame);
+
+	return frame.last_error != SCOM_ERROR_NO_ERROR ? -1 : 0;
+}
+
+uint16_t xcic_codec_calc_checksum(const char *data, uint_fast16_t length)
+{
+	uint_fast8_t A = 0xFF, B = 0;
+
+	while (length--) {
+		A = (A + *data++) & 0xFF;
+		B = (B + A) & 0xFF;
+	}
+
+	return (B & 0xFF) << 8 | (A & 0xFF);
+}
+
+const char *xcic_codec_strerror(scom_error_t error)
+{
+	/* not a scomlib error, kept out of the switch over them */
+	if ((unsigned)error == XCIC_ERROR_CANCELLED)
+		return "cancelled";
+
+	switch (error) {
+	case SCOM_ERROR_NO_ERROR:
+		return "no_error";
+	case SCOM_ERROR_INVALID_FRAME:
+		return "invalid_frame";
+	case SCOM_ERROR_DEVICE_NOT_FOUND:
+		return "device_not_found";
+	case SCOM_ERROR_RESPONSE_TIMEOUT:
+		return "response_timeout";
+	case SCOM_ERROR_SERVICE_NOT_SUPPORTED:
+		return "service_not_supported";
+	case SCOM_ERROR_INVALID_SERVICE_ARGUMENT:
+		return "invalid_service_argument";
+	case SCOM_ERROR_GATEWAY_BUSY:
+		return "gateway_busy";
+	case SCOM_ERROR_TYPE_NOT_SUPPORTED:
+		return "type_not_supported";
+	case SCOM_ERROR_OBJECT_ID_NOT_FOUND:
+		return "object_id_not_found";
+	case SCOM_ERROR_PROPERTY_NOT_SUPPORTED:
+		return "property_not_supported";
+	case SCOM_ERROR_INVALID_DATA_LENGTH:
+		return "invalid_data_length";
+	case SCOM_ERROR_PROPERTY_IS_READ_ONLY:
+		return "property_is_read_only";
+	case SCOM_ERROR_INVALID_DATA:
+		return "invalid_data";
+	case SCOM_ERROR_DATA_TOO_SMALL:
+		return "data_too_small";
+	case SCOM_ERROR_DATA_TOO_BIG:
+		return "data_too_big";
+	case SCOM_ERROR_WRITE_PROPERTY_FAILED:
+		return "write_property_failed";
+	case SCOM_ERROR_READ_PROPERTY_FAILED:
+		return "read_property_failed";
+	case SCOM_ERROR_ACCESS_DENIED:
+		return "access_denied";
+	case SCOM_ERROR_OBJECT_NOT_SUPPORTED:
+		return "object_not_supported";
+	case SCOM_ERROR_MULTICAST_READ_NOT_SUPPORTED:
+		return "multicast_read_not_supported";
+	case SCOM_ERROR_INVALID_SHELL_ARG:
+		return "invalid_shell_arg";
+	case SCOM_ERROR_STACK_PORT_NOT_FOUND:
+		return "stack_port_not_found";
+	case SCOM_ERROR_STACK_PORT_INIT_FAILED:
+		return "stack_port_init_failed";
+	case SCOM_ERROR_STACK_PORT_WRITE_FAILED:
+		return "stack_port_write_failed";
+	case SCOM_ERROR_STACK_PORT_READ_FAILED:
+		return "stack_port_read_failed";
+	case SCOM_ERROR_STACK_BUFFER_TOO_SMALL:
+		return "stack_buffer_too_small";
+	case SCOM_ERROR_STACK_PROPERTY_HEADER_DOESNT_MATCH:
+		return "stack_property_header_doesnt_match";
+	default:
+		return "unknown";
+	}
+}
@@ -0,0 +1,70 @@
+/*
+Copyright (c) 2020 Maxim Galaganov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef XCIC_CODEC_H
+#define XCIC_CODEC_H
+
+/*
+ * SCOM frame codec on top of scomlib, free of Lua and of the serial port.
+ *
+ * Functions returning int yield 0 on success and -1 on failure, with the
+ * reason left in `frame->last_error`.
+ */
+
+#include <small/ibuf.h>
+
+#include <scom_property.h>
+
+/** Encodes a read property request with optional `data` into `ibuf`. */
+int xcic_codec_encode_read_property(struct ibuf *ibuf, scom_property_t *property,
+				    const char *data, size_t data_len);
+
+/** Encodes a write property request carrying `data` into `ibuf`. */
+int xcic_codec_encode_write_property(struct ibuf *ibuf, scom_property_t *property,
+				     const char *data, size_t data_len);
+
+/** Completes an encoded property request with the data link header and checksums. */
+int xcic_codec_encode_request_frame(struct ibuf *ibuf, scom_frame_t *frame);
+
+/** Largest read property request: data link header, service and property headers, checksum. */
+#define XCIC_CODEC_REQUEST_SIZE_MAX (SCOM_FRAME_HEADER_SIZE + 2 + 8 + 2)
+
+/** A read property request encoded once and sent as is, checksums included. */
+struct xcic_request {
+	uint32_t dst_addr;
+	scom_object_type_t object_type;
+	uint32_t object_id;
+	uint16_t property_id;
+	size_t length;
+	char frame[XCIC_CODEC_REQUEST_SIZE_MAX];
+};
+
+/** Encodes the read property request described by the key fields of `request`. */
+int xcic_codec_prepare_read_property(struct xcic_request *request);
+
+/** An exchange given up because its fiber was cancelled; the port stays open. */
+#define XCIC_ERROR_CANCELLED ((scom_error_t)0x0088)
+
+uint16_t xcic_codec_calc_checksum(const char *data, uint_fast16_t length);
+
+const char *xcic_codec_strerror(scom_error_t error);
+
+#endif /* XCIC_CODEC_H */
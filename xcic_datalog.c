@@ -0,0 +1,471 @@
+/*
+Copyright (c) 2020 Maxim Galaganov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "xcic_datalog.h"
+
+#include <msgpuck.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* array header, ts, object_id, instance, double */
+#define XCIC_DATALOG_TUPLE_SIZE_MAX (1 + 9 + 5 + 5 + XCIC_DATALOG_INSTANCE_SIZE_MAX + 9)
+
+static const char *xcic_datalog_cell(const char **pos, const char *end, char sep, size_t *len);
+static int xcic_datalog_number(const char **p, const char *end, int digits);
+static int xcic_datalog_id_parse(const char *cell, size_t len, struct xcic_datalog_column *col);
+static int xcic_datalog_ts_parse(const char *cell, size_t len, uint64_t *ts);
+static int xcic_datalog_value_parse(const char *cell, size_t len, char sep, double *value);
+static int xcic_datalog_tuple_add(struct xcic_datalog *log, uint64_t ts,
+				  const struct xcic_datalog_column *col, double value);
+static int xcic_datalog_columns_set(struct xcic_datalog *log, const char *line, size_t len,
+				    char sep);
+static int xcic_datalog_entry_parse(const char *line, size_t len,
+				    struct xcic_datalog_entry *entry);
+
+/* next cell of `line`, without surrounding blanks and quotes */
+const char *xcic_datalog_cell(const char **pos, const char *end, char sep, size_t *len)
+{
+	const char *cell = *pos;
+	const char *next = memchr(cell, sep, end - cell);
+	const char *cell_end = next ? next : end;
+
+	*pos = next ? next + 1 : NULL;
+
+	while (cell < cell_end && (*cell == ' ' || *cell == '"'))
+		cell++;
+	while (cell_end > cell && (cell_end[-1] == ' ' || cell_end[-1] == '"'))
+		cell_end--;
+
+	*len = cell_end - cell;
+
+	return cell;
+}
+
+int xcic_datalog_parse(struct xcic_datalog *log, const char *data, size_t size)
+{
+	const char *end = data + size;
+	const char *line = data;
+	char sep = 0;
+
+	while (line < end) {
+		const char *eol = memchr(line, '\n', end - line);
+		const char *next = eol ? eol + 1 : end;
+		if (!eol)
+			eol = end;
+		if (eol > line && eol[-1] == '\r')
+			eol--;
+
+		size_t len = eol - line;
+
+		if (!len) {
+			line = next;
+			continue;
+		}
+
+		if (!sep) {
+			size_t commas = 0, semicolons = 0;
+			for (size_t i = 0; i < len; i++) {
+				commas += line[i] == ',';
+				semicolons += line[i] == ';';
+			}
+			sep = semicolons > commas ? ';' : ',';
+		}
+
+		const char *pos = line;
+		size_t cell_len;
+		const char *cell = xcic_datalog_cell(&pos, eol, sep, &cell_len);
+
+		uint64_t ts;
+
+		if (!log->column_count) {
+			if (xcic_datalog_columns_set(log, line, len, sep))
+				return -1;
+		} else if (!xcic_datalog_ts_parse(cell, cell_len, &ts)) {
+			log->row_count++;
+
+			for (size_t i = 1; pos && i < log->column_count; i++) {
+				cell = xcic_datalog_cell(&pos, eol, sep, &cell_len);
+
+				double value;
+				if (!log->columns[i].object_id ||
+				    xcic_datalog_value_parse(cell, cell_len, sep, &value))
+					continue;
+
+				if (xcic_datalog_tuple_add(log, ts, &log->columns[i], value))
+					return -1;
+			}
+		}
+
+		line = next;
+	}
+
+	if (!log->column_count) {
+		snprintf(log->errmsg, sizeof(log->errmsg), "no object id header row");
+		return -1;
+	}
+
+	return 0;
+}
+
+int xcic_datalog_parse_file(struct xcic_datalog *log, const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		snprintf(log->errmsg, sizeof(log->errmsg), "open: %s", strerror(errno));
+		return -1;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		snprintf(log->errmsg, sizeof(log->errmsg), "fstat: %s", strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	if (!st.st_size) {
+		close(fd);
+		return xcic_datalog_parse(log, "", 0);
+	}
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		snprintf(log->errmsg, sizeof(log->errmsg), "mmap: %s", strerror(errno));
+		return -1;
+	}
+
+	int ret = xcic_datalog_parse(log, (const char *)data, st.st_size);
+
+	munmap(data, st.st_size);
+
+	return ret;
+}
+
+void xcic_datalog_destroy(struct xcic_datalog *log)
+{
+	free(log->columns);
+	free(log->tuples);
+	memset(log, 0, sizeof(*log));
+}
+
+/* a header row is the one where some cell reads like `I3090 L1-1` */
+int xcic_datalog_columns_set(struct xcic_datalog *log, const char *line, size_t len, char sep)
+{
+	const char *pos = line;
+	const char *end = line + len;
+	size_t count = 0, ids = 0;
+
+	while (pos) {
+		size_t cell_len;
+		(void)xcic_datalog_cell(&pos, end, sep, &cell_len);
+		count++;
+	}
+
+	struct xcic_datalog_column *columns =
+	    (struct xcic_datalog_column *)calloc(count, sizeof(*columns));
+	if (!columns) {
+		snprintf(log->errmsg, sizeof(log->errmsg), "alloc failed");
+		return -1;
+	}
+
+	pos = line;
+	for (size_t i = 0; pos; i++) {
+		size_t cell_len;
+		const char *cell = xcic_datalog_cell(&pos, end, sep, &cell_len);
+
+		if (i && !xcic_datalog_id_parse(cell, cell_len, &columns[i]))
+			ids++;
+	}
+
+	if (!ids) {
+		free(columns);
+		return 0;
+	}
+
+	log->columns = columns;
+	log->column_count = count;
+
+	return 0;
+}
+
+int xcic_datalog_id_parse(const char *cell, size_t len, struct xcic_datalog_column *col)
+{
+	size_t i = 0;
+	uint32_t id = 0;
+
+	if (i < len && (cell[i] == 'I' || cell[i] == 'i' || cell[i] == 'P' || cell[i] == 'p'))
+		i++;
+
+	size_t digits = i;
+	while (i < len && cell[i] >= '0' && cell[i] <= '9' && id < 100000)
+		id = id * 10 + (cell[i++] - '0');
+
+	if (i - digits < 3 || i - digits > 5 || (i < len && cell[i] != ' '))
+		return -1;
+
+	while (i < len && cell[i] == ' ')
+		i++;
+
+	size_t instance_len = len - i;
+	if (instance_len >= sizeof(col->instance))
+		instance_len = sizeof(col->instance) - 1;
+
+	col->object_id = id;
+	memcpy(col->instance, &cell[i], instance_len);
+	col->instance[instance_len] = '\0';
+
+	return 0;
+}
+
+int xcic_datalog_number(const char **p, const char *end, int digits)
+{
+	int n = 0;
+
+	for (int i = 0; i < digits; i++) {
+		if (*p >= end || **p < '0' || **p > '9')
+			return -1;
+		n = n * 10 + (*(*p)++ - '0');
+	}
+
+	return n;
+}
+
+/* `dd.mm.yyyy hh:mm[:ss]` or `yyyy-mm-dd hh:mm[:ss]`, device local time taken for UTC */
+int xcic_datalog_ts_parse(const char *cell, size_t len, uint64_t *ts)
+{
+	const char *p = cell;
+	const char *end = cell + len;
+	struct tm tm = {0};
+
+	if (len >= 10 && cell[2] == '.' && cell[5] == '.') {
+		tm.tm_mday = xcic_datalog_number(&p, end, 2);
+		p++;
+		tm.tm_mon = xcic_datalog_number(&p, end, 2) - 1;
+		p++;
+		tm.tm_year = xcic_datalog_number(&p, end, 4) - 1900;
+	} else if (len >= 10 && cell[4] == '-' && cell[7] == '-') {
+		tm.tm_year = xcic_datalog_number(&p, end, 4) - 1900;
+		p++;
+		tm.tm_mon = xcic_datalog_number(&p, end, 2) - 1;
+		p++;
+		tm.tm_mday = xcic_datalog_number(&p, end, 2);
+	} else {
+		return -1;
+	}
+
+	if (tm.tm_mday < 1 || tm.tm_mon < 0 || tm.tm_year < 0)
+		return -1;
+
+	while (p < end && (*p == ' ' || *p == 'T'))
+		p++;
+
+	if (p < end) {
+		tm.tm_hour = xcic_datalog_number(&p, end, 2);
+		if (p < end && *p == ':')
+			p++;
+		tm.tm_min = xcic_datalog_number(&p, end, 2);
+		if (p < end && *p == ':') {
+			p++;
+			tm.tm_sec = xcic_datalog_number(&p, end, 2);
+		}
+
+		if (tm.tm_hour < 0 || tm.tm_min < 0 || tm.tm_sec < 0)
+			return -1;
+	}
+
+	time_t t = timegm(&tm);
+	if (t == (time_t)-1)
+		return -1;
+
+	*ts = (uint64_t)t;
+
+	return 0;
+}
+
+int xcic_datalog_value_parse(const char *cell, size_t len, char sep, double *value)
+{
+	char buf[64];
+
+	if (!len || len >= sizeof(buf))
+		return -1;
+
+	memcpy(buf, cell, len);
+	buf[len] = '\0';
+
+	/* `;` separated files come with decimal commas */
+	if (sep == ';') {
+		for (size_t i = 0; i < len; i++)
+			if (buf[i] == ',')
+				buf[i] = '.';
+	}
+
+	char *endptr;
+	*value = strtod(buf, &endptr);
+
+	return endptr == buf || *endptr != '\0' ? -1 : 0;
+}
+
+int xcic_datalog_tuple_add(struct xcic_datalog *log, uint64_t ts,
+			   const struct xcic_datalog_column *col, double value)
+{
+	if (log->tuples_size + XCIC_DATALOG_TUPLE_SIZE_MAX > log->tuples_capacity) {
+		size_t capacity = log->tuples_capacity ? log->tuples_capacity * 2 : 64 * 1024;
+
+		char *tuples = (char *)realloc(log->tuples, capacity);
+		if (!tuples) {
+			snprintf(log->errmsg, sizeof(log->errmsg), "alloc failed");
+			return -1;
+		}
+
+		log->tuples = tuples;
+		log->tuples_capacity = capacity;
+	}
+
+	char *p = log->tuples + log->tuples_size;
+
+	p = mp_encode_array(p, 4);
+	p = mp_encode_uint(p, ts);
+	p = mp_encode_uint(p, col->object_id);
+	p = mp_encode_str(p, col->instance, strlen(col->instance));
+	p = mp_encode_double(p, value);
+
+	log->tuples_size = p - log->tuples;
+	log->tuple_count++;
+
+	return 0;
+}
+
+int xcic_datalog_dir_parse(const char *data, size_t size, struct xcic_datalog_entry **entries,
+			   size_t *count)
+{
+	const char *end = data + size;
+	size_t capacity = 0;
+
+	*entries = NULL;
+	*count = 0;
+
+	for (const char *line = data; line < end;) {
+		const char *eol = memchr(line, '\n', end - line);
+		const char *next = eol ? eol + 1 : end;
+		size_t len = (eol ? eol : end) - line;
+
+		struct xcic_datalog_entry entry;
+
+		if (!xcic_datalog_entry_parse(line, len, &entry)) {
+			if (*count == capacity) {
+				capacity = capacity ? capacity * 2 : 64;
+
+				struct xcic_datalog_entry *tmp;
+				tmp = (struct xcic_datalog_entry *)realloc(*entries,
+									   capacity * sizeof(*tmp));
+				if (!tmp) {
+					free(*entries);
+					*entries = NULL;
+					*count = 0;
+					return -1;
+				}
+
+				*entries = tmp;
+			}
+
+			(*entries)[(*count)++] = entry;
+		}
+
+		line = next;
+	}
+
+	return 0;
+}
+
+/* the first field that looks like a file name, then a plain number and a date */
+int xcic_datalog_entry_parse(const char *line, size_t len, struct xcic_datalog_entry *entry)
+{
+	const char *p = line;
+	const char *end = line + len;
+	int have_size = 0;
+
+	memset(entry, 0, sizeof(*entry));
+
+	while (p < end) {
+		while (p < end && strchr(" \t\r,;\"", *p))
+			p++;
+
+		const char *field = p;
+		while (p < end && !strchr(" \t\r,;\"", *p))
+			p++;
+
+		size_t flen = p - field;
+		if (!flen)
+			continue;
+
+		if (!entry->name[0]) {
+			if (flen >= sizeof(entry->name) || !memchr(field, '.', flen))
+				return -1;
+
+			memcpy(entry->name, field, flen);
+			entry->name[flen] = '\0';
+			continue;
+		}
+
+		uint64_t ts;
+		if (!entry->mtime && flen >= 10 && !xcic_datalog_ts_parse(field, flen, &ts)) {
+			/* the time of day, if any, comes as the next field */
+			const char *q = p;
+			while (q < end && strchr(" \t,;", *q))
+				q++;
+
+			const char *tod = q;
+			while (q < end && ((*q >= '0' && *q <= '9') || *q == ':'))
+				q++;
+
+			char buf[32];
+			if (q - tod >= 5 && flen + 1 + (q - tod) < sizeof(buf)) {
+				snprintf(buf, sizeof(buf), "%.*s %.*s", (int)flen, field,
+					 (int)(q - tod), tod);
+				if (!xcic_datalog_ts_parse(buf, strlen(buf), &ts))
+					p = q;
+			}
+
+			entry->mtime = ts;
+			continue;
+		}
+
+		if (!have_size) {
+			char *endptr;
+			unsigned long long n = strtoull(field, &endptr, 10);
+			if (endptr == field + flen && *field >= '0' && *field <= '9') {
+				entry->size = n;
+				have_size = 1;
+			}
+		}
+	}
+
+	return entry->name[0] ? 0 : -1;
+}
@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2020 Maxim Galaganov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef XCIC_DATALOG_H
+#define XCIC_DATALOG_H
+
+/*
+ * Parser of the CSV files the Xcom-232i writes to its SD card, free of Lua
+ * and of the event loop so that it can run on coio worker threads.
+ *
+ * The layout is a few header rows followed by one row per minute:
+ *
+ *   ,XT-Ubat- (MIN) [Vdc],XT-Uin [Vac],...
+ *   ,I3090 L1-1,I3113 L1-1,...
+ *   01.09.2020 00:00,51.25,229.5,...
+ *
+ * The header row naming the objects maps columns to object ids, the text
+ * after the id (`L1-1`, the device instance) is kept as is. Columns without
+ * an id, rows without a timestamp and empty cells are skipped. Both `,` and
+ * `;` separated files are accepted, the latter with decimal commas.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define XCIC_DATALOG_INSTANCE_SIZE_MAX 16
+#define XCIC_DATALOG_NAME_SIZE_MAX 64
+
+struct xcic_datalog_column {
+	/** Object id of the column, 0 if the column is not a value. */
+	uint32_t object_id;
+	char instance[XCIC_DATALOG_INSTANCE_SIZE_MAX];
+};
+
+struct xcic_datalog {
+	struct xcic_datalog_column *columns;
+	size_t column_count;
+	/** Tuples [ts, object_id, instance, value] as MsgPack arrays back to back. */
+	char *tuples;
+	size_t tuples_size;
+	size_t tuples_capacity;
+	size_t tuple_count;
+	/** Rows with a timestamp. */
+	size_t row_count;
+	/** Why parsing failed. */
+	char errmsg[128];
+};
+
+/** Parses `size` bytes of CSV, returns 0 or -1 with `log->errmsg` set. */
+int xcic_datalog_parse(struct xcic_datalog *log, const char *data, size_t size);
+
+/** Reads and parses the file at `path`, returns 0 or -1 with `log->errmsg` set. */
+int xcic_datalog_parse_file(struct xcic_datalog *log, const char *path);
+
+void xcic_datalog_destroy(struct xcic_datalog *log);
+
+/** A file of the datalog directory listing. */
+struct xcic_datalog_entry {
+	char name[XCIC_DATALOG_NAME_SIZE_MAX];
+	/** Size in bytes. */
+	uint64_t size;
+	/** Modification time, 0 if the listing has none. */
+	uint64_t mtime;
+};
+
+/*
+ * Parses the directory listing, one file per line: the name comes first,
+ * followed by its size and date in any order, separated by blanks, `,` or
+ * `;`. Lines without a name are skipped. On success `*entries` is to be
+ * freed by the caller, returns 0 or -1 if out of memory.
+ */
+int xcic_datalog_dir_parse(const char *data, size_t size, struct xcic_datalog_entry **entries,
+			   size_t *count);
+
+#endif /* XCIC_DATALOG_H */
@@ -0,0 +1,302 @@
+/*
+Copyright (c) 2020 Maxim Galaganov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "xcic_series.h"
+
+#include <string.h>
+
+/* worst case of a sample: `1111` and a 32 bit delta, `11`, 5 + 6 bit lengths and 64 bits */
+#define XCIC_SERIES_SAMPLE_BITS_MAX (4 + 32 + 2 + 5 + 6 + 64)
+
+static void xcic_series_put(struct xcic_series_block *block, uint64_t value, int bits);
+static int xcic_series_get(struct xcic_series_iter *it, int bits, uint64_t *value);
+static uint64_t xcic_series_double_bits(double value);
+static double xcic_series_bits_double(uint64_t bits);
+
+void xcic_series_block_init(struct xcic_series_block *block)
+{
+	memset(block, 0, sizeof(*block));
+	block->lead_prev = -1;
+	block->trail_prev = -1;
+}
+
+int xcic_series_block_append(struct xcic_series_block *block, uint64_t ts, double value)
+{
+	if (block->bits + XCIC_SERIES_SAMPLE_BITS_MAX > XCIC_SERIES_BLOCK_SIZE * 8)
+		return -1;
+
+	uint64_t v = xcic_series_double_bits(value);
+
+	if (!block->count) {
+		xcic_series_put(block, ts, 64);
+		xcic_series_put(block, v, 64);
+
+		block->t0 = ts;
+		block->t_prev = ts;
+		block->value_prev = v;
+		block->count = 1;
+
+		return 0;
+	}
+
+	int64_t delta = (int64_t)(ts - block->t_prev);
+	int64_t dod = delta - block->delta_prev;
+
+	if (dod == 0) {
+		xcic_series_put(block, 0x0, 1);
+	} else if (dod >= -63 && dod <= 64) {
+		xcic_series_put(block, 0x2, 2);
+		xcic_series_put(block, (uint64_t)(dod + 63), 7);
+	} else if (dod >= -255 && dod <= 256) {
+		xcic_series_put(block, 0x6, 3);
+		xcic_series_put(block, (uint64_t)(dod + 255), 9);
+	} else if (dod >= -2047 && dod <= 2048) {
+		xcic_series_put(block, 0xe, 4);
+		xcic_series_put(block, (uint64_t)(dod + 2047), 12);
+	} else {
+		xcic_series_put(block, 0xf, 4);
+		xcic_series_put(block, (uint64_t)(uint32_t)(int32_t)dod, 32);
+	}
+
+	uint64_t x = v ^ block->value_prev;
+
+	if (!x) {
+		xcic_series_put(block, 0x0, 1);
+	} else {
+		int lead = __builtin_clzll(x);
+		int trail = __builtin_ctzll(x);
+
+		if (lead > 31)
+			lead = 31;
+
+		if (block->lead_prev >= 0 && lead >= block->lead_prev &&
+		    trail >= block->trail_prev) {
+			/* fits into the window of the previous XOR */
+			int len = 64 - block->lead_prev - block->trail_prev;
+
+			xcic_series_put(block, 0x2, 2);
+			xcic_series_put(block, x >> block->trail_prev, len);
+		} else {
+			int len = 64 - lead - trail;
+
+			xcic_series_put(block, 0x3, 2);
+			xcic_series_put(block, lead, 5);
+			xcic_series_put(block, len - 1, 6);
+			xcic_series_put(block, x >> trail, len);
+
+			block->lead_prev = lead;
+			block->trail_prev = trail;
+		}
+	}
+
+	block->t_prev = ts;
+	block->delta_prev = delta;
+	block->value_prev = v;
+	block->count++;
+
+	return 0;
+}
+
+size_t xcic_series_block_size(const struct xcic_series_block *block)
+{
+	return (block->bits + 7) / 8;
+}
+
+void xcic_series_iter_create(struct xcic_series_iter *it, const char *data, size_t size,
+			     uint32_t count)
+{
+	memset(it, 0, sizeof(*it));
+	it->data = (const uint8_t *)data;
+	it->size = size * 8;
+	it->left = count;
+	it->lead_prev = -1;
+	it->trail_prev = -1;
+	it->first = 1;
+}
+
+int xcic_series_iter_next(struct xcic_series_iter *it, uint64_t *ts, double *value)
+{
+	uint64_t b, n;
+
+	if (!it->left)
+		return 0;
+
+	if (it->first) {
+		if (xcic_series_get(it, 64, &it->t_prev) ||
+		    xcic_series_get(it, 64, &it->value_prev))
+			return -1;
+
+		it->first = 0;
+		goto done;
+	}
+
+	/* delta of delta: count the leading ones of the prefix */
+	int ones = 0;
+	while (ones < 4) {
+		if (xcic_series_get(it, 1, &b))
+			return -1;
+		if (!b)
+			break;
+		ones++;
+	}
+
+	int64_t dod;
+
+	switch (ones) {
+	case 0:
+		dod = 0;
+		break;
+	case 1:
+		if (xcic_series_get(it, 7, &n))
+			return -1;
+		dod = (int64_t)n - 63;
+		break;
+	case 2:
+		if (xcic_series_get(it, 9, &n))
+			return -1;
+		dod = (int64_t)n - 255;
+		break;
+	case 3:
+		if (xcic_series_get(it, 12, &n))
+			return -1;
+		dod = (int64_t)n - 2047;
+		break;
+	default:
+		if (xcic_series_get(it, 32, &n))
+			return -1;
+		dod = (int32_t)(uint32_t)n;
+		break;
+	}
+
+	it->delta_prev += dod;
+	it->t_prev += it->delta_prev;
+
+	if (xcic_series_get(it, 1, &b))
+		return -1;
+
+	if (b) {
+		if (xcic_series_get(it, 1, &b))
+			return -1;
+
+		if (!b) {
+			if (it->lead_prev < 0)
+				return -1;
+
+			int len = 64 - it->lead_prev - it->trail_prev;
+			if (xcic_series_get(it, len, &n))
+				return -1;
+
+			it->value_prev ^= n << it->trail_prev;
+		} else {
+			uint64_t lead, len;
+			if (xcic_series_get(it, 5, &lead) || xcic_series_get(it, 6, &len))
+				return -1;
+
+			len++;
+			if (lead + len > 64)
+				return -1;
+
+			if (xcic_series_get(it, len, &n))
+				return -1;
+
+			it->lead_prev = lead;
+			it->trail_prev = 64 - lead - len;
+			it->value_prev ^= n << it->trail_prev;
+		}
+	}
+
+done:
+	it->left--;
+
+	*ts = it->t_prev;
+	*value = xcic_series_bits_double(it->value_prev);
+
+	return 1;
+}
+
+int xcic_series_rollup_add(struct xcic_series_rollup *rollup, uint64_t ts, double value,
+			   struct xcic_series_rollup *done)
+{
+	uint64_t bucket = ts - ts % rollup->period;
+	int closed = 0;
+
+	if (rollup->count && bucket != rollup->bucket) {
+		*done = *rollup;
+		closed = 1;
+		rollup->count = 0;
+	}
+
+	if (!rollup->count) {
+		rollup->bucket = bucket;
+		rollup->min = value;
+		rollup->max = value;
+		rollup->sum = 0;
+	}
+
+	if (value < rollup->min)
+		rollup->min = value;
+	if (value > rollup->max)
+		rollup->max = value;
+
+	rollup->sum += value;
+	rollup->count++;
+
+	return closed;
+}
+
+/* most significant bit first */
+void xcic_series_put(struct xcic_series_block *block, uint64_t value, int bits)
+{
+	for (int i = bits - 1; i >= 0; i--) {
+		if ((value >> i) & 1)
+			block->data[block->bits / 8] |= 0x80 >> (block->bits % 8);
+		block->bits++;
+	}
+}
+
+int xcic_series_get(struct xcic_series_iter *it, int bits, uint64_t *value)
+{
+	if (it->pos + bits > it->size)
+		return -1;
+
+	*value = 0;
+
+	for (int i = 0; i < bits; i++) {
+		*value = (*value << 1) | ((it->data[it->pos / 8] >> (7 - it->pos % 8)) & 1);
+		it->pos++;
+	}
+
+	return 0;
+}
+
+uint64_t xcic_series_double_bits(double value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+double xcic_series_bits_double(uint64_t bits)
+{
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
@@ -0,0 +1,104 @@
+/*
+Copyright (c) 2020 Maxim Galaganov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef XCIC_SERIES_H
+#define XCIC_SERIES_H
+
+/*
+ * Compressed blocks of float samples and their rollups, free of Lua and of
+ * the event loop.
+ *
+ * A block starts with the first timestamp (ms) and value in full; each next
+ * sample stores the delta of its timestamp delta and the XOR of its value
+ * with the previous one, both with variable length prefixes. A steadily
+ * polled value that does not change costs two bits per sample.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define XCIC_SERIES_BLOCK_SIZE 256
+
+struct xcic_series_block {
+	uint8_t data[XCIC_SERIES_BLOCK_SIZE];
+	/** Bits written. */
+	size_t bits;
+	/** Samples written. */
+	uint32_t count;
+	/** Timestamp of the first sample, ms. */
+	uint64_t t0;
+	uint64_t t_prev;
+	int64_t delta_prev;
+	uint64_t value_prev;
+	/** Leading and trailing zeros of the previous XOR, -1 before the first one. */
+	int lead_prev;
+	int trail_prev;
+};
+
+/** Reads a block back, sample by sample. */
+struct xcic_series_iter {
+	const uint8_t *data;
+	size_t size;
+	size_t pos;
+	uint32_t left;
+	uint64_t t_prev;
+	int64_t delta_prev;
+	uint64_t value_prev;
+	int lead_prev;
+	int trail_prev;
+	/** Set until the first sample is read. */
+	int first;
+};
+
+/** Min, max and average of the samples falling into one bucket. */
+struct xcic_series_rollup {
+	/** Bucket length, s. */
+	uint32_t period;
+	/** Start of the current bucket, s; 0 before the first sample. */
+	uint64_t bucket;
+	double min;
+	double max;
+	double sum;
+	uint32_t count;
+};
+
+void xcic_series_block_init(struct xcic_series_block *block);
+
+/** Appends a sample, returns -1 if the block is full and left unchanged. */
+int xcic_series_block_append(struct xcic_series_block *block, uint64_t ts, double value);
+
+/** Bytes of the encoded samples. */
+size_t xcic_series_block_size(const struct xcic_series_block *block);
+
+void xcic_series_iter_create(struct xcic_series_iter *it, const char *data, size_t size,
+			     uint32_t count);
+
+/** Returns 1 with the next sample, 0 at the end or -1 if the block is corrupt. */
+int xcic_series_iter_next(struct xcic_series_iter *it, uint64_t *ts, double *value);
+
+/*
+ * Accounts a sample at `ts` (s). When the sample opens a new bucket, the
+ * finished one is copied to `done` and 1 is returned.
+ */
+int xcic_series_rollup_add(struct xcic_series_rollup *rollup, uint64_t ts, double value,
+			   struct xcic_series_rollup *done);
+
+#endif /* XCIC_SERIES_H */
@@ -0,0 +1,453 @@
+/*
+Copyright (c) 2020 Maxim Galaganov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Offline decoder of serial traffic captured with xp:start_capture().
+ *
+ *   xcireplay [-v] capture...
+ *
+ * Files are read in the order given, rotated ones oldest first. Frames are
+ * hunted for in the TX and RX bytes the same way the module does it and
+ * responses are matched to the request before them. Prints one JSON object
+ * per line: every frame with -v, then totals, error counts and response
+ * latency histograms per object type.
+ */
+#include "xcic_capture.h"
+#include "xcic_codec.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define XCIREPLAY_START_BYTE 0xAA
+#define XCIREPLAY_DATA_SIZE_MAX 1024
+#define XCIREPLAY_OBJECT_TYPES_MAX 16
+#define XCIREPLAY_ERRORS_MAX 64
+
+/* upper bounds of the latency buckets, ms; the last one catches the rest */
+static const double xcireplay_buckets[] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000};
+
+#define XCIREPLAY_BUCKET_COUNT (SCOM_NBR_ELEMENTS(xcireplay_buckets) + 1)
+
+/* bytes of one direction not parsed into frames yet */
+struct xcireplay_stream {
+	char buf[2 * (SCOM_FRAME_HEADER_SIZE + XCIREPLAY_DATA_SIZE_MAX + 2)];
+	size_t len;
+};
+
+struct xcireplay_frame {
+	uint32_t src_addr;
+	uint32_t dst_addr;
+	uint8_t service_flags;
+	uint8_t service_id;
+	uint16_t object_type;
+	uint32_t object_id;
+	uint16_t property_id;
+	const char *value;
+	size_t value_length;
+};
+
+struct xcireplay_latency {
+	uint16_t object_type;
+	uint64_t count;
+	double sum;
+	double max;
+	uint64_t buckets[XCIREPLAY_BUCKET_COUNT];
+};
+
+struct xcireplay_error {
+	/** 0 for an error returned by a device, 1 for a failed exchange. */
+	int exchange;
+	uint16_t code;
+	uint64_t count;
+};
+
+static int xcireplay_verbose;
+static uint64_t xcireplay_t0;
+
+static struct xcireplay_stream xcireplay_tx;
+static struct xcireplay_stream xcireplay_rx;
+
+/* the request waiting for its response */
+static struct xcireplay_frame xcireplay_request;
+static uint64_t xcireplay_request_ts;
+static int xcireplay_pending;
+
+static struct {
+	uint64_t files;
+	uint64_t records;
+	uint64_t tx_bytes;
+	uint64_t rx_bytes;
+	uint64_t tx_frames;
+	uint64_t rx_frames;
+	uint64_t rx_skipped;
+	uint64_t bad_checksums;
+	uint64_t unanswered;
+	uint64_t unmatched;
+} xcireplay_totals;
+
+static struct xcireplay_latency xcireplay_latencies[XCIREPLAY_OBJECT_TYPES_MAX];
+static size_t xcireplay_latency_count;
+
+static struct xcireplay_error xcireplay_errors[XCIREPLAY_ERRORS_MAX];
+static size_t xcireplay_error_count;
+
+static uint32_t xcireplay_le(const char *buf, int size)
+{
+	uint32_t value = 0;
+
+	for (int i = size - 1; i >= 0; i--)
+		value = (value << 8) | (uint8_t)buf[i];
+
+	return value;
+}
+
+static void xcireplay_error_add(int exchange, uint16_t code)
+{
+	for (size_t i = 0; i < xcireplay_error_count; i++) {
+		if (xcireplay_errors[i].exchange == exchange && xcireplay_errors[i].code == code) {
+			xcireplay_errors[i].count++;
+			return;
+		}
+	}
+
+	if (xcireplay_error_count == XCIREPLAY_ERRORS_MAX)
+		return;
+
+	struct xcireplay_error *e = &xcireplay_errors[xcireplay_error_count++];
+	e->exchange = exchange;
+	e->code = code;
+	e->count = 1;
+}
+
+static void xcireplay_latency_add(uint16_t object_type, double ms)
+{
+	struct xcireplay_latency *l = NULL;
+
+	for (size_t i = 0; i < xcireplay_latency_count; i++) {
+		if (xcireplay_latencies[i].object_type == object_type)
+			l = &xcireplay_latencies[i];
+	}
+
+	if (!l) {
+		if (xcireplay_latency_count == XCIREPLAY_OBJECT_TYPES_MAX)
+			return;
+		l = &xcireplay_latencies[xcireplay_latency_count++];
+		l->object_type = object_type;
+	}
+
+	size_t b = 0;
+	while (b < SCOM_NBR_ELEMENTS(xcireplay_buckets) && ms > xcireplay_buckets[b])
+		b++;
+
+	l->buckets[b]++;
+	l->count++;
+	l->sum += ms;
+	if (ms > l->max)
+		l->max = ms;
+}
+
+static void xcireplay_frame_print(const char *dir, uint64_t ts, const struct xcireplay_frame *f,
+				  double latency)
+{
+	printf("{\"ts\": %.6f, \"dir\": \"%s\", \"src\": %u, \"dst\": %u, \"service\": %u, "
+	       "\"object_type\": %u, \"object_id\": %u, \"property_id\": %u, \"length\": %zu",
+	       (ts - xcireplay_t0) / 1e9, dir, f->src_addr, f->dst_addr, f->service_id,
+	       f->object_type, f->object_id, f->property_id, f->value_length);
+
+	if ((f->service_flags & 0x1) && f->value_length >= 2)
+		printf(", \"error\": \"%s\"",
+		       xcic_codec_strerror((scom_error_t)xcireplay_le(f->value, 2)));
+
+	if (latency >= 0)
+		printf(", \"latency_ms\": %.3f", latency);
+
+	printf("}\n");
+}
+
+static void xcireplay_on_frame(int rx, uint64_t ts, const struct xcireplay_frame *f)
+{
+	double latency = -1;
+
+	if (!rx) {
+		xcireplay_totals.tx_frames++;
+
+		if (xcireplay_pending)
+			xcireplay_totals.unanswered++;
+
+		xcireplay_request = *f;
+		xcireplay_request_ts = ts;
+		xcireplay_pending = 1;
+	} else {
+		xcireplay_totals.rx_frames++;
+
+		if (xcireplay_pending && f->src_addr == xcireplay_request.dst_addr) {
+			latency = (ts - xcireplay_request_ts) / 1e6;
+			xcireplay_latency_add(xcireplay_request.object_type, latency);
+			xcireplay_pending = 0;
+		} else {
+			xcireplay_totals.unmatched++;
+		}
+
+		if ((f->service_flags & 0x1) && f->value_length >= 2)
+			xcireplay_error_add(0, xcireplay_le(f->value, 2));
+	}
+
+	if (xcireplay_verbose)
+		xcireplay_frame_print(rx ? "rx" : "tx", ts, f, latency);
+}
+
+/* mirrors xcic_intl_port_recv_frame(): resync on the start byte, check both checksums */
+static void xcireplay_hunt(struct xcireplay_stream *s, int rx, uint64_t ts)
+{
+	size_t pos = 0;
+
+	for (;;) {
+		const char *start = (const char *)memchr(s->buf + pos, XCIREPLAY_START_BYTE,
+							 s->len - pos);
+		size_t skip = (start ? (size_t)(start - s->buf) : s->len) - pos;
+
+		if (rx)
+			xcireplay_totals.rx_skipped += skip;
+		pos += skip;
+
+		if (s->len - pos < SCOM_FRAME_HEADER_SIZE)
+			break;
+
+		const char *h = s->buf + pos;
+		size_t data_length = xcireplay_le(&h[10], 2);
+
+		if (xcic_codec_calc_checksum(&h[1], SCOM_FRAME_HEADER_SIZE - 3) !=
+			xcireplay_le(&h[12], 2) ||
+		    data_length > XCIREPLAY_DATA_SIZE_MAX) {
+			if (rx)
+				xcireplay_totals.rx_skipped++;
+			pos++;
+			continue;
+		}
+
+		size_t length = SCOM_FRAME_HEADER_SIZE + data_length + 2;
+		if (s->len - pos < length)
+			break;
+
+		const char *d = h + SCOM_FRAME_HEADER_SIZE;
+
+		if (xcic_codec_calc_checksum(d, data_length) != xcireplay_le(d + data_length, 2)) {
+			xcireplay_totals.bad_checksums++;
+		} else if (data_length >= 10) {
+			struct xcireplay_frame f = {
+			    .src_addr = xcireplay_le(&h[2], 4),
+			    .dst_addr = xcireplay_le(&h[6], 4),
+			    .service_flags = (uint8_t)d[0],
+			    .service_id = (uint8_t)d[1],
+			    .object_type = xcireplay_le(&d[2], 2),
+			    .object_id = xcireplay_le(&d[4], 4),
+			    .property_id = xcireplay_le(&d[8], 2),
+			    .value = d + 10,
+			    .value_length = data_length - 10,
+			};
+
+			xcireplay_on_frame(rx, ts, &f);
+		}
+
+		pos += length;
+	}
+
+	memmove(s->buf, s->buf + pos, s->len - pos);
+	s->len -= pos;
+}
+
+static void xcireplay_feed(struct xcireplay_stream *s, int rx, uint64_t ts, const char *data,
+			   size_t len)
+{
+	while (len > 0) {
+		size_t n = sizeof(s->buf) - s->len;
+		if (n > len)
+			n = len;
+
+		memcpy(s->buf + s->len, data, n);
+		s->len += n;
+		data += n;
+		len -= n;
+
+		xcireplay_hunt(s, rx, ts);
+
+		/* no frame fits what is left, drop it */
+		if (s->len == sizeof(s->buf)) {
+			if (rx)
+				xcireplay_totals.rx_skipped += s->len;
+			s->len = 0;
+		}
+	}
+}
+
+static int xcireplay_file(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		fprintf(stderr, "xcireplay: %s: %m\n", path);
+		return -1;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size < XCIC_CAPTURE_MAGIC_SIZE) {
+		fprintf(stderr, "xcireplay: %s: not a capture\n", path);
+		close(fd);
+		return -1;
+	}
+
+	const char *data = (const char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "xcireplay: %s: %m\n", path);
+		return -1;
+	}
+
+	int ret = -1;
+
+	if (memcmp(data, XCIC_CAPTURE_MAGIC, XCIC_CAPTURE_MAGIC_SIZE)) {
+		fprintf(stderr, "xcireplay: %s: not a capture\n", path);
+		goto out;
+	}
+
+	(void)madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+
+	const char *pos = data + XCIC_CAPTURE_MAGIC_SIZE;
+	const char *end = data + st.st_size;
+	struct xcic_capture_record r;
+	int rc;
+
+	while ((rc = xcic_capture_next(&pos, end, &r)) > 0) {
+		if (!xcireplay_t0)
+			xcireplay_t0 = r.ts;
+
+		xcireplay_totals.records++;
+
+		switch (r.kind) {
+		case XCIC_CAPTURE_TX:
+			/* whatever is still pending answers an earlier request */
+			xcireplay_totals.rx_skipped += xcireplay_rx.len;
+			xcireplay_rx.len = 0;
+
+			xcireplay_totals.tx_bytes += r.length;
+			xcireplay_feed(&xcireplay_tx, 0, r.ts, r.data, r.length);
+			break;
+		case XCIC_CAPTURE_RX:
+			xcireplay_totals.rx_bytes += r.length;
+			xcireplay_feed(&xcireplay_rx, 1, r.ts, r.data, r.length);
+			break;
+		case XCIC_CAPTURE_ERROR:
+			if (r.length >= 2)
+				xcireplay_error_add(1, xcireplay_le(r.data, 2));
+			xcireplay_pending = 0;
+			break;
+		}
+	}
+
+	/* the tail of a file being written may be cut short */
+	if (rc < 0)
+		fprintf(stderr, "xcireplay: %s: truncated record at %zu\n", path,
+			(size_t)(pos - data));
+
+	xcireplay_totals.files++;
+	ret = 0;
+
+out:
+	munmap((void *)data, st.st_size);
+
+	return ret;
+}
+
+static void xcireplay_report(void)
+{
+	printf("{\"files\": %" PRIu64 ", \"records\": %" PRIu64 ", \"tx_bytes\": %" PRIu64
+	       ", \"rx_bytes\": %" PRIu64 ", \"tx_frames\": %" PRIu64 ", \"rx_frames\": %" PRIu64
+	       ", \"rx_skipped\": %" PRIu64 ", \"bad_checksums\": %" PRIu64
+	       ", \"unanswered\": %" PRIu64 ", \"unmatched\": %" PRIu64 "}\n",
+	       xcireplay_totals.files, xcireplay_totals.records, xcireplay_totals.tx_bytes,
+	       xcireplay_totals.rx_bytes, xcireplay_totals.tx_frames, xcireplay_totals.rx_frames,
+	       xcireplay_totals.rx_skipped, xcireplay_totals.bad_checksums,
+	       xcireplay_totals.unanswered, xcireplay_totals.unmatched);
+
+	for (size_t i = 0; i < xcireplay_error_count; i++) {
+		const struct xcireplay_error *e = &xcireplay_errors[i];
+
+		printf("{\"error\": \"%s\", \"source\": \"%s\", \"count\": %" PRIu64 "}\n",
+		       xcic_codec_strerror((scom_error_t)e->code),
+		       e->exchange ? "exchange" : "device", e->count);
+	}
+
+	for (size_t i = 0; i < xcireplay_latency_count; i++) {
+		const struct xcireplay_latency *l = &xcireplay_latencies[i];
+
+		printf("{\"object_type\": %u, \"count\": %" PRIu64
+		       ", \"avg_ms\": %.3f, \"max_ms\": %.3f, \"buckets\": {",
+		       l->object_type, l->count, l->count ? l->sum / l->count : 0, l->max);
+
+		for (size_t b = 0; b < XCIREPLAY_BUCKET_COUNT; b++) {
+			if (b < SCOM_NBR_ELEMENTS(xcireplay_buckets))
+				printf("\"%g\": %" PRIu64 ", ", xcireplay_buckets[b],
+				       l->buckets[b]);
+			else
+				printf("\"+Inf\": %" PRIu64, l->buckets[b]);
+		}
+
+		printf("}}\n");
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "v")) != -1) {
+		switch (opt) {
+		case 'v':
+			xcireplay_verbose = 1;
+			break;
+		default:
+			goto usage;
+		}
+	}
+
+	if (optind == argc)
+		goto usage;
+
+	int failed = 0;
+
+	for (int i = optind; i < argc; i++)
+		failed |= xcireplay_file(argv[i]);
+
+	xcireplay_report();
+
+	return failed ? 1 : 0;
+
+usage:
+	fprintf(stderr, "Usage: xcireplay [-v] capture...\n");
+	return 1;
+}
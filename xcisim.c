@@ -0,0 +1,720 @@
+/*
+Copyright (c) 2020 Maxim Galaganov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Xcom-232i simulator: serves SCOM requests on a pseudo-terminal.
+ *
+ *   xcisim [-b baud] [-l latency_ms] [-t pct] [-c pct] [-g pct] [-s seed] [-L link] [-v] fixture
+ *
+ * The slave side of the pty (or the -L symlink to it) is printed on stdout
+ * and can be passed to xcic.open_port().
+ */
+#include <scom_property.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define XCISIM_FRAME_SIZE_MAX 1024
+#define XCISIM_BLOCK_SIZE 256
+#define XCISIM_VALUE_SIZE_MAX 16
+
+#define XCISIM_MESSAGE_OBJECT_TYPE 3
+#define XCISIM_DATALOG_OBJECT_TYPE 0x101
+
+enum xcisim_xfer_state {
+	XCISIM_XFER_START = 0x21,     /*SD_Start*/
+	XCISIM_XFER_DATABLOCK = 0x22, /*SD_Datablock*/
+	XCISIM_XFER_CONTINUE = 0x23,  /*SD_Ack_Continue*/
+	XCISIM_XFER_RETRY = 0x24,     /*SD_Nack_Retry*/
+	XCISIM_XFER_ABORT = 0x25,     /*SD_Abort*/
+	XCISIM_XFER_FINISH = 0x26,    /*SD_Finish*/
+};
+
+/** Fixture record: an object value, a message or a datalog file. */
+struct xcisim_object {
+	uint32_t dst_addr;
+	uint16_t object_type;
+	uint32_t object_id;
+	uint16_t property_id;
+	char value[XCISIM_VALUE_SIZE_MAX];
+	size_t value_length;
+	/** Datalog file name (empty for the directory listing). */
+	char *filename;
+	/** Datalog file contents. */
+	char *data;
+	size_t data_length;
+};
+
+/** Simulator options and state. */
+struct xcisim {
+	int master;
+	int slave;
+	unsigned baud;
+	unsigned latency_ms;
+	unsigned timeout_pct;
+	unsigned checksum_pct;
+	unsigned busy_pct;
+	unsigned seed;
+	int verbose;
+
+	struct xcisim_object *objects;
+	size_t object_count;
+
+	/** Ongoing datalog transfer. */
+	struct xcisim_object *xfer;
+	size_t xfer_offset;
+	size_t xfer_block;
+
+	char rbuf[XCISIM_FRAME_SIZE_MAX];
+	size_t rlen;
+};
+
+static uint16_t xcisim_checksum(const char *data, size_t length)
+{
+	uint_fast8_t A = 0xFF, B = 0;
+
+	while (length--) {
+		A = (A + *data++) & 0xFF;
+		B = (B + A) & 0xFF;
+	}
+
+	return (B & 0xFF) << 8 | (A & 0xFF);
+}
+
+static int xcisim_roll(struct xcisim *sim, unsigned pct)
+{
+	return pct && (unsigned)(rand_r(&sim->seed) % 100) < pct;
+}
+
+static void xcisim_sleep_us(uint64_t us)
+{
+	struct timespec ts = {.tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000};
+
+	while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+		;
+}
+
+static char *xcisim_slurp(const char *pathname, size_t *length)
+{
+	FILE *f = fopen(pathname, "rb");
+	if (!f)
+		return NULL;
+
+	char *data = NULL;
+	size_t size = 0;
+	size_t used = 0;
+
+	for (;;) {
+		if (used == size) {
+			size = size ? size * 2 : 4096;
+			char *p = realloc(data, size);
+			if (!p) {
+				free(data);
+				data = NULL;
+				break;
+			}
+			data = p;
+		}
+
+		size_t n = fread(data + used, 1, size - used, f);
+		if (n == 0)
+			break;
+		used += n;
+	}
+
+	fclose(f);
+	*length = used;
+
+	return data;
+}
+
+static int xcisim_encode_value(struct xcisim_object *o, const char *format, const char *value)
+{
+	if (!strcmp(format, "float")) {
+		scom_write_le_float(o->value, strtof(value, NULL));
+		o->value_length = 4;
+	} else if (!strcmp(format, "int32")) {
+		scom_write_le32(o->value, (uint32_t)strtoll(value, NULL, 0));
+		o->value_length = 4;
+	} else if (!strcmp(format, "enum") || !strcmp(format, "le16")) {
+		scom_write_le16(o->value, (uint16_t)strtol(value, NULL, 0));
+		o->value_length = 2;
+	} else if (!strcmp(format, "bool")) {
+		o->value[0] = strtol(value, NULL, 0) != 0;
+		o->value_length = 1;
+	} else {
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Fixture lines:
+ *
+ *   info    <addr> <object_id> <format> <value>
+ *   param   <addr> <object_id> <property_id> <format> <value>
+ *   message <addr> <index> <type> <src_addr> <timestamp> <value>
+ *   dir     <addr> <path>
+ *   file    <addr> <filename> <path>
+ *
+ * Formats are float, int32, enum (le16) and bool.
+ */
+static int xcisim_load_fixture(struct xcisim *sim, const char *pathname)
+{
+	FILE *f = fopen(pathname, "r");
+	if (!f) {
+		fprintf(stderr, "xcisim: %s: %s\n", pathname, strerror(errno));
+		return -1;
+	}
+
+	char line[512];
+	int lineno = 0;
+
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+
+		char *p = line + strspn(line, " \t");
+		if (*p == '#' || *p == '\n' || *p == '\0')
+			continue;
+
+		struct xcisim_object *objects =
+		    realloc(sim->objects, (sim->object_count + 1) * sizeof(*objects));
+		if (!objects)
+			goto fail;
+		sim->objects = objects;
+
+		struct xcisim_object *o = &sim->objects[sim->object_count];
+		memset(o, 0, sizeof(*o));
+
+		char kind[16], a[128], b[128], c[128], d[128], e[128];
+		unsigned addr;
+		int n = sscanf(p, "%15s %u %127s %127s %127s %127s %127s", kind, &addr, a, b, c, d,
+			       e);
+
+		o->dst_addr = addr;
+
+		if (!strcmp(kind, "info") && n >= 5) {
+			o->object_type = SCOM_USER_INFO_OBJECT_TYPE;
+			o->object_id = strtoul(a, NULL, 0);
+			o->property_id = 1;
+			if (xcisim_encode_value(o, b, c))
+				goto fail;
+		} else if (!strcmp(kind, "param") && n >= 6) {
+			o->object_type = SCOM_PARAMETER_OBJECT_TYPE;
+			o->object_id = strtoul(a, NULL, 0);
+			o->property_id = strtoul(b, NULL, 0);
+			if (xcisim_encode_value(o, c, d))
+				goto fail;
+		} else if (!strcmp(kind, "message") && n >= 7) {
+			o->object_type = XCISIM_MESSAGE_OBJECT_TYPE;
+			o->object_id = strtoul(a, NULL, 0);
+			o->data = calloc(1, 4 + 2 + 4 + 4 + 4);
+			if (!o->data)
+				goto fail;
+			o->data_length = 4 + 2 + 4 + 4 + 4;
+			scom_write_le16(&o->data[4], (uint16_t)strtoul(b, NULL, 0));
+			scom_write_le32(&o->data[6], strtoul(c, NULL, 0));
+			scom_write_le32(&o->data[10], strtoul(d, NULL, 0));
+			scom_write_le32(&o->data[14], strtoul(e, NULL, 0));
+		} else if (!strcmp(kind, "dir") && n >= 3) {
+			o->object_type = XCISIM_DATALOG_OBJECT_TYPE;
+			o->object_id = 1;
+			o->filename = strdup("");
+			o->data = xcisim_slurp(a, &o->data_length);
+			if (!o->filename || !o->data)
+				goto fail;
+		} else if (!strcmp(kind, "file") && n >= 4) {
+			o->object_type = XCISIM_DATALOG_OBJECT_TYPE;
+			o->object_id = 2;
+			o->filename = strdup(a);
+			o->data = xcisim_slurp(b, &o->data_length);
+			if (!o->filename || !o->data)
+				goto fail;
+		} else {
+			goto fail;
+		}
+
+		sim->object_count++;
+	}
+
+	fclose(f);
+
+	/* every message carries the number of messages of its source */
+	for (size_t i = 0; i < sim->object_count; i++) {
+		struct xcisim_object *o = &sim->objects[i];
+		if (o->object_type != XCISIM_MESSAGE_OBJECT_TYPE)
+			continue;
+
+		uint32_t count = 0;
+		for (size_t j = 0; j < sim->object_count; j++)
+			count += sim->objects[j].object_type == XCISIM_MESSAGE_OBJECT_TYPE &&
+				 sim->objects[j].dst_addr == o->dst_addr;
+
+		scom_write_le32(&o->data[0], count);
+	}
+
+	return 0;
+
+fail:
+	fprintf(stderr, "xcisim: %s:%d: invalid fixture line\n", pathname, lineno);
+	fclose(f);
+
+	return -1;
+}
+
+static struct xcisim_object *xcisim_find(struct xcisim *sim, uint32_t dst_addr,
+					 uint16_t object_type, uint32_t object_id,
+					 uint16_t property_id, const char *filename,
+					 size_t filename_len)
+{
+	for (size_t i = 0; i < sim->object_count; i++) {
+		struct xcisim_object *o = &sim->objects[i];
+
+		if (o->dst_addr != dst_addr || o->object_type != object_type ||
+		    o->object_id != object_id)
+			continue;
+
+		switch (object_type) {
+		case SCOM_USER_INFO_OBJECT_TYPE:
+			return o;
+		case SCOM_PARAMETER_OBJECT_TYPE:
+			if (o->property_id == property_id)
+				return o;
+			break;
+		case XCISIM_MESSAGE_OBJECT_TYPE:
+			return o;
+		case XCISIM_DATALOG_OBJECT_TYPE:
+			if (object_id == 1 || (strlen(o->filename) == filename_len &&
+					       !memcmp(o->filename, filename, filename_len)))
+				return o;
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static int xcisim_device_exists(struct xcisim *sim, uint32_t dst_addr)
+{
+	for (size_t i = 0; i < sim->object_count; i++)
+		if (sim->objects[i].dst_addr == dst_addr)
+			return 1;
+
+	return 0;
+}
+
+/** Writes the frame pacing it as a real line running at sim->baud would. */
+static void xcisim_send(struct xcisim *sim, const char *buf, size_t len)
+{
+	/* 8 data bits, even parity, start and stop bits */
+	uint64_t byte_us = sim->baud ? 11 * 1000000ULL / sim->baud : 0;
+
+	while (len > 0) {
+		size_t chunk = len < 16 ? len : 16;
+
+		ssize_t n = write(sim->master, buf, chunk);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			fprintf(stderr, "xcisim: write: %s\n", strerror(errno));
+			return;
+		}
+
+		buf += n;
+		len -= n;
+
+		if (byte_us)
+			xcisim_sleep_us(byte_us * n);
+	}
+}
+
+/** Encodes a response to the request and sends it back. */
+static void xcisim_respond(struct xcisim *sim, scom_frame_t *request, uint16_t object_type,
+			   uint32_t object_id, uint16_t property_id, scom_error_t error,
+			   const char *value, size_t value_length)
+{
+	char buf[XCISIM_FRAME_SIZE_MAX];
+
+	scom_frame_t frame;
+	scom_initialize_frame(&frame, buf, sizeof(buf));
+
+	frame.src_addr = request->dst_addr;
+	frame.dst_addr = request->src_addr;
+
+	scom_property_t property;
+	scom_initialize_property(&property, &frame);
+
+	property.object_type = (scom_object_type_t)object_type;
+	property.object_id = object_id;
+	property.property_id = property_id;
+
+	char code[2];
+	if (error != SCOM_ERROR_NO_ERROR) {
+		scom_write_le16(code, (uint16_t)error);
+		value = code;
+		value_length = sizeof(code);
+	}
+
+	if (value_length + 2 > property.value_buffer_size)
+		value_length = property.value_buffer_size - 2;
+
+	if (request->service_id == SCOM_WRITE_PROPERTY_SERVICE) {
+		property.value_length = error != SCOM_ERROR_NO_ERROR ? value_length : 0;
+		scom_encode_write_property(&property);
+	} else {
+		scom_encode_read_property(&property);
+		frame.data_length += value_length;
+	}
+
+	memcpy(property.value_buffer, value, value_length);
+
+	scom_encode_request_frame(&frame);
+
+	/* scom_encode_request_frame() always produces request service flags */
+	frame.buffer[SCOM_FRAME_HEADER_SIZE] = 0x2 | (error != SCOM_ERROR_NO_ERROR);
+
+	uint16_t cs = xcisim_checksum(&frame.buffer[SCOM_FRAME_HEADER_SIZE], frame.data_length);
+	if (xcisim_roll(sim, sim->checksum_pct)) {
+		cs ^= 0x5A5A;
+		if (sim->verbose)
+			fprintf(stderr, "xcisim: injecting bad checksum\n");
+	}
+	scom_write_le16(&frame.buffer[SCOM_FRAME_HEADER_SIZE + frame.data_length], cs);
+
+	xcisim_send(sim, frame.buffer, scom_frame_length(&frame));
+}
+
+static void xcisim_handle_xfer(struct xcisim *sim, scom_frame_t *request, uint32_t object_id,
+			       uint16_t property_id, const char *data, size_t data_len)
+{
+	struct xcisim_object *o;
+
+	switch (property_id) {
+	case XCISIM_XFER_START:
+		o = xcisim_find(sim, request->dst_addr, XCISIM_DATALOG_OBJECT_TYPE, object_id, 0,
+				data, data_len);
+		if (!o) {
+			xcisim_respond(sim, request, XCISIM_DATALOG_OBJECT_TYPE, object_id,
+				       property_id, SCOM_ERROR_OBJECT_ID_NOT_FOUND, NULL, 0);
+			return;
+		}
+		sim->xfer = o;
+		sim->xfer_offset = 0;
+		sim->xfer_block = 0;
+		break;
+	case XCISIM_XFER_CONTINUE:
+		if (!sim->xfer)
+			goto invalid;
+		sim->xfer_offset += sim->xfer_block;
+		break;
+	case XCISIM_XFER_RETRY:
+		if (!sim->xfer)
+			goto invalid;
+		break;
+	case XCISIM_XFER_ABORT:
+		sim->xfer = NULL;
+		xcisim_respond(sim, request, XCISIM_DATALOG_OBJECT_TYPE, object_id,
+			       XCISIM_XFER_ABORT, SCOM_ERROR_NO_ERROR, NULL, 0);
+		return;
+	default:
+		goto invalid;
+	}
+
+	o = sim->xfer;
+
+	if (sim->xfer_offset >= o->data_length) {
+		sim->xfer = NULL;
+		xcisim_respond(sim, request, XCISIM_DATALOG_OBJECT_TYPE, object_id,
+			       XCISIM_XFER_FINISH, SCOM_ERROR_NO_ERROR, NULL, 0);
+		return;
+	}
+
+	sim->xfer_block = o->data_length - sim->xfer_offset;
+	if (sim->xfer_block > XCISIM_BLOCK_SIZE)
+		sim->xfer_block = XCISIM_BLOCK_SIZE;
+
+	xcisim_respond(sim, request, XCISIM_DATALOG_OBJECT_TYPE, object_id,
+		       XCISIM_XFER_DATABLOCK, SCOM_ERROR_NO_ERROR, o->data + sim->xfer_offset,
+		       sim->xfer_block);
+	return;
+
+invalid:
+	xcisim_respond(sim, request, XCISIM_DATALOG_OBJECT_TYPE, object_id, property_id,
+		       SCOM_ERROR_INVALID_SERVICE_ARGUMENT, NULL, 0);
+}
+
+static void xcisim_handle(struct xcisim *sim, char *buf, size_t len)
+{
+	scom_frame_t frame;
+	scom_initialize_frame(&frame, buf, len);
+
+	scom_decode_frame_header(&frame);
+	if (frame.last_error != SCOM_ERROR_NO_ERROR) {
+		fprintf(stderr, "xcisim: dropping request with invalid header\n");
+		return;
+	}
+
+	uint16_t cs = scom_read_le16(&buf[SCOM_FRAME_HEADER_SIZE + frame.data_length]);
+	if (cs != xcisim_checksum(&buf[SCOM_FRAME_HEADER_SIZE], frame.data_length) ||
+	    frame.data_length < 2 + 8) {
+		fprintf(stderr, "xcisim: dropping request with invalid data\n");
+		return;
+	}
+
+	frame.service_id = (scom_service_t)buf[SCOM_FRAME_HEADER_SIZE + 1];
+
+	const char *header = &buf[SCOM_FRAME_HEADER_SIZE + 2];
+	uint16_t object_type = scom_read_le16(&header[0]);
+	uint32_t object_id = scom_read_le32(&header[2]);
+	uint16_t property_id = scom_read_le16(&header[6]);
+	char *value = &buf[SCOM_FRAME_HEADER_SIZE + 2 + 8];
+	size_t value_length = frame.data_length - 2 - 8;
+
+	if (sim->verbose)
+		fprintf(stderr, "xcisim: <- svc %d dst %u type 0x%x obj %u prop 0x%x len %zu\n",
+			frame.service_id, frame.dst_addr, object_type, object_id, property_id,
+			value_length);
+
+	if (xcisim_roll(sim, sim->timeout_pct)) {
+		if (sim->verbose)
+			fprintf(stderr, "xcisim: injecting timeout\n");
+		return;
+	}
+
+	if (sim->latency_ms)
+		xcisim_sleep_us(sim->latency_ms * 1000ULL);
+
+	if (xcisim_roll(sim, sim->busy_pct)) {
+		if (sim->verbose)
+			fprintf(stderr, "xcisim: injecting gateway_busy\n");
+		xcisim_respond(sim, &frame, object_type, object_id, property_id,
+			       SCOM_ERROR_GATEWAY_BUSY, NULL, 0);
+		return;
+	}
+
+	if (!xcisim_device_exists(sim, frame.dst_addr)) {
+		xcisim_respond(sim, &frame, object_type, object_id, property_id,
+			       SCOM_ERROR_DEVICE_NOT_FOUND, NULL, 0);
+		return;
+	}
+
+	if (object_type == XCISIM_DATALOG_OBJECT_TYPE) {
+		xcisim_handle_xfer(sim, &frame, object_id, property_id, value, value_length);
+		return;
+	}
+
+	struct xcisim_object *o =
+	    xcisim_find(sim, frame.dst_addr, object_type, object_id, property_id, NULL, 0);
+	if (!o) {
+		xcisim_respond(sim, &frame, object_type, object_id, property_id,
+			       SCOM_ERROR_OBJECT_ID_NOT_FOUND, NULL, 0);
+		return;
+	}
+
+	if (frame.service_id == SCOM_WRITE_PROPERTY_SERVICE) {
+		if (object_type != SCOM_PARAMETER_OBJECT_TYPE) {
+			xcisim_respond(sim, &frame, object_type, object_id, property_id,
+				       SCOM_ERROR_PROPERTY_IS_READ_ONLY, NULL, 0);
+			return;
+		}
+		if (value_length != o->value_length) {
+			xcisim_respond(sim, &frame, object_type, object_id, property_id,
+				       SCOM_ERROR_INVALID_DATA_LENGTH, NULL, 0);
+			return;
+		}
+		memcpy(o->value, value, value_length);
+		xcisim_respond(sim, &frame, object_type, object_id, property_id,
+			       SCOM_ERROR_NO_ERROR, NULL, 0);
+		return;
+	}
+
+	if (o->data)
+		xcisim_respond(sim, &frame, object_type, object_id, property_id,
+			       SCOM_ERROR_NO_ERROR, o->data, o->data_length);
+	else
+		xcisim_respond(sim, &frame, object_type, object_id, property_id,
+			       SCOM_ERROR_NO_ERROR, o->value, o->value_length);
+}
+
+/** Consumes complete frames from the receive buffer, skipping garbage. */
+static void xcisim_process(struct xcisim *sim)
+{
+	for (;;) {
+		char *start = memchr(sim->rbuf, 0xAA, sim->rlen);
+		if (!start) {
+			sim->rlen = 0;
+			return;
+		}
+
+		size_t skip = start - sim->rbuf;
+		if (skip) {
+			memmove(sim->rbuf, start, sim->rlen - skip);
+			sim->rlen -= skip;
+		}
+
+		if (sim->rlen < SCOM_FRAME_HEADER_SIZE)
+			return;
+
+		size_t len = SCOM_FRAME_HEADER_SIZE + scom_read_le16(&sim->rbuf[10]) + 2;
+		if (len > sizeof(sim->rbuf) ||
+		    scom_read_le16(&sim->rbuf[12]) !=
+			xcisim_checksum(&sim->rbuf[1], SCOM_FRAME_HEADER_SIZE - 1 - 2)) {
+			/* not a frame start, resynchronise on the next start byte */
+			memmove(sim->rbuf, sim->rbuf + 1, sim->rlen - 1);
+			sim->rlen -= 1;
+			continue;
+		}
+
+		if (sim->rlen < len)
+			return;
+
+		xcisim_handle(sim, sim->rbuf, len);
+
+		memmove(sim->rbuf, sim->rbuf + len, sim->rlen - len);
+		sim->rlen -= len;
+	}
+}
+
+static int xcisim_open_pty(struct xcisim *sim, const char *link)
+{
+	sim->master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (sim->master == -1 || grantpt(sim->master) == -1 || unlockpt(sim->master) == -1) {
+		fprintf(stderr, "xcisim: pty: %s\n", strerror(errno));
+		return -1;
+	}
+
+	const char *name = ptsname(sim->master);
+
+	/* keep the slave open so the master survives client reconnects */
+	sim->slave = open(name, O_RDWR | O_NOCTTY);
+	if (sim->slave == -1) {
+		fprintf(stderr, "xcisim: %s: %s\n", name, strerror(errno));
+		return -1;
+	}
+
+	struct termios tty;
+	if (tcgetattr(sim->slave, &tty) == 0) {
+		cfmakeraw(&tty);
+		(void)tcsetattr(sim->slave, TCSANOW, &tty);
+	}
+
+	if (link) {
+		(void)unlink(link);
+		if (symlink(name, link) == -1) {
+			fprintf(stderr, "xcisim: symlink %s: %s\n", link, strerror(errno));
+			return -1;
+		}
+		name = link;
+	}
+
+	printf("%s\n", name);
+	fflush(stdout);
+
+	return 0;
+}
+
+static void xcisim_usage(void)
+{
+	fprintf(stderr, "Usage: xcisim [-b baud] [-l latency_ms] [-t timeout_pct] "
+			"[-c bad_checksum_pct] [-g gateway_busy_pct] [-s seed] [-L link] [-v] "
+			"fixture\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct xcisim sim = {.master = -1, .slave = -1, .baud = 38400, .seed = 1};
+	const char *link = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:l:t:c:g:s:L:v")) != -1) {
+		switch (opt) {
+		case 'b':
+			sim.baud = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			sim.latency_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			sim.timeout_pct = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			sim.checksum_pct = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			sim.busy_pct = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			sim.seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'L':
+			link = optarg;
+			break;
+		case 'v':
+			sim.verbose = 1;
+			break;
+		default:
+			xcisim_usage();
+			return 1;
+		}
+	}
+
+	if (optind >= argc) {
+		xcisim_usage();
+		return 1;
+	}
+
+	if (xcisim_load_fixture(&sim, argv[optind]))
+		return 1;
+
+	if (xcisim_open_pty(&sim, link))
+		return 1;
+
+	for (;;) {
+		struct pollfd pfd = {.fd = sim.master, .events = POLLIN};
+
+		if (poll(&pfd, 1, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "xcisim: poll: %s\n", strerror(errno));
+			return 1;
+		}
+
+		ssize_t n = read(sim.master, sim.rbuf + sim.rlen, sizeof(sim.rbuf) - sim.rlen);
+		if (n == -1 && (errno == EINTR || errno == EAGAIN))
+			continue;
+		if (n <= 0) {
+			fprintf(stderr, "xcisim: read: %s\n", n ? strerror(errno) : "eof");
+			return 1;
+		}
+
+		sim.rlen += n;
+		xcisim_process(&sim);
+	}
+}